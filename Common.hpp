@@ -46,10 +46,10 @@ struct MeshSettings
     static constexpr int VerticesPerPolygon = 6;
 
     static constexpr std::uint32_t FileSignature = 'NNAV';
-    static constexpr std::uint32_t FileVersion = '0006';
+    static constexpr std::uint32_t FileVersion = '0007';
     static constexpr std::uint32_t FileADT = 'ADT\0';
     static constexpr std::uint32_t FileWMO = 'WMO\0';
-    static constexpr std::uint32_t FileMap = 'MAP1';
+    static constexpr std::uint32_t FileMap = 'MAP3';
     static constexpr std::uint32_t WMOcoordinate = 0xFFFFFFFF;
 
     // Nothing below here should ever have to change
@@ -90,6 +90,87 @@ struct MeshSettings
     static_assert(CellSize > 0.f, "CellSize must be positive");
 };
 
+// the model index written by the builder's BVHConstructor and read by the
+// pathfind library
+namespace bvhfiles
+{
+static constexpr std::uint32_t IndexSignature = 'BIDX';
+static constexpr std::uint32_t IndexVersion = 1;
+
+#pragma pack(push, 1)
+// the index file is a header, followed by one Model record per model id, then
+// the Obstacle records sorted by display id, then the string data to which the
+// Model offsets refer
+struct IndexHeader
+{
+    std::uint32_t signature;
+    std::uint32_t version;
+    std::uint32_t modelCount;
+    std::uint32_t obstacleCount;
+    std::uint32_t stringsSize;
+};
+
+struct Model
+{
+    std::uint32_t mpqPathOffset;
+    std::uint32_t mpqPathLength;
+    std::uint32_t bvhFileOffset;
+    std::uint32_t bvhFileLength;
+};
+
+struct Obstacle
+{
+    std::uint32_t displayId;
+    std::uint32_t modelId;
+};
+#pragma pack(pop)
+} // namespace bvhfiles
+
+// the navigation graph written by the builder's PortalGraphBuilder and read by
+// the pathfind library
+namespace graphfiles
+{
+static constexpr std::uint32_t FileSignature = 'GRPH';
+static constexpr std::uint32_t FileVersion = 2;
+
+// component id of polygons which cannot be walked upon
+static constexpr std::uint32_t NoComponent = 0xFFFFFFFF;
+
+// the navigation graph is divided into square clusters of this many tiles
+static constexpr int TilesPerCluster = MeshSettings::TilesPerADT;
+
+#pragma pack(push, 1)
+// identifies a polygon independently of the order in which tiles are loaded
+struct PolyLocation
+{
+    std::int32_t tileX;
+    std::int32_t tileY;
+    std::uint32_t poly;
+};
+
+// a portal lies on the border between two clusters
+struct Node
+{
+    float position[3]; // recast coordinates
+    std::uint32_t clusters[2];
+    PolyLocation polys[2];
+};
+
+struct Edge
+{
+    std::uint32_t from;
+    std::uint32_t to;
+    float cost;
+};
+#pragma pack(pop)
+
+inline std::uint32_t ClusterId(int tileX, int tileY)
+{
+    return (static_cast<std::uint32_t>(tileY / TilesPerCluster) << 16) |
+           static_cast<std::uint32_t>(tileX / TilesPerCluster);
+}
+} // namespace graphfiles
+
 enum class Result {
     SUCCESS = 0,
     UNRECOGNIZED_EXTENSION = 1,
@@ -205,5 +286,10 @@ enum class Result {
 
     FAILED_TO_FIND_POINT_BETWEEN_VECTORS = 89,
 
+    UNKNOWN_PATH_REQUEST = 90,
+    PATH_REQUEST_IN_PROGRESS = 91,
+
+    INVALID_GRAPH_FILE = 92,
+
     UNKNOWN_EXCEPTION = 0xFF,
 };
@@ -4,6 +4,8 @@
 #include "utility/Exception.hpp"
 #include "utility/PicoSHA2/picosha2.h"
 
+#include <algorithm>
+#include <fstream>
 #include <iomanip>
 #include <mutex>
 #include <sstream>
@@ -19,33 +21,37 @@ BVHConstructor::BVHConstructor(const fs::path& outputPath)
 
     utility::BinaryStream index(index_file);
 
-    std::uint32_t num_bvh, num_obstacles;
-    index >> num_bvh;
+    bvhfiles::IndexHeader header;
+    index >> header;
 
-    for (auto i = 0u; i < num_bvh; ++i)
-    {
-        std::uint32_t length;
-        index >> length;
-
-        auto const mpq_path = index.ReadString(length);
+    // an index in an older format is rebuilt from scratch, along with every
+    // model which is written again
+    if (header.signature != bvhfiles::IndexSignature ||
+        header.version != bvhfiles::IndexVersion)
+        return;
 
-        index >> length;
+    std::vector<bvhfiles::Model> models(header.modelCount);
+    if (!models.empty())
+        index.ReadBytes(&models[0], models.size() * sizeof(bvhfiles::Model));
 
-        auto const bvh_path = index.ReadString(length);
+    std::vector<bvhfiles::Obstacle> obstacles(header.obstacleCount);
+    if (!obstacles.empty())
+        index.ReadBytes(&obstacles[0],
+                        obstacles.size() * sizeof(bvhfiles::Obstacle));
 
-        m_files[mpq_path] = bvh_path;
-    }
+    auto const strings = index.ReadString(header.stringsSize);
 
-    index >> num_obstacles;
-
-    for (auto i = 0u; i < num_obstacles; ++i)
+    for (auto const& model : models)
     {
-        std::uint32_t entry, length;
-
-        index >> entry >> length;
-
-        m_temporaryObstacles[entry] = index.ReadString(length);
+        m_modelIds[strings.substr(model.mpqPathOffset, model.mpqPathLength)] =
+            static_cast<std::uint32_t>(m_models.size());
+        m_models.emplace_back(
+            strings.substr(model.mpqPathOffset, model.mpqPathLength),
+            strings.substr(model.bvhFileOffset, model.bvhFileLength));
     }
+
+    for (auto const& obstacle : obstacles)
+        m_temporaryObstacles[obstacle.displayId] = obstacle.modelId;
 }
 
 BVHConstructor::~BVHConstructor()
@@ -54,13 +60,32 @@ BVHConstructor::~BVHConstructor()
         Shutdown();
 }
 
-fs::path BVHConstructor::InternalAddFile(const fs::path& mpq_path)
+std::uint32_t BVHConstructor::InternalAddFile(const fs::path& mpq_path)
 {
-    auto const it = m_files.find(mpq_path.string());
+    auto const mpq_path_str = mpq_path.string();
+    auto const it = m_modelIds.find(mpq_path_str);
 
-    if (it != m_files.end())
+    if (it != m_modelIds.end())
         return it->second;
 
+    // the .bvh file is named once the model has been serialized
+    auto const id = static_cast<std::uint32_t>(m_models.size());
+
+    m_modelIds[mpq_path_str] = id;
+    m_models.emplace_back(mpq_path_str, std::string());
+
+    return id;
+}
+
+bool BVHConstructor::Claim(const fs::path& mpq_path)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    return m_claimedModels.insert(InternalAddFile(mpq_path)).second;
+}
+
+void BVHConstructor::WriteModel(const fs::path& mpq_path,
+                                utility::BinaryStream& data, bool empty)
+{
     auto const extension = mpq_path.extension().string();
 
     std::string kind;
@@ -71,36 +96,84 @@ fs::path BVHConstructor::InternalAddFile(const fs::path& mpq_path)
     else
         THROW(Result::UNRECOGNIZED_EXTENSION);
 
-    // compute sha256 checksum of path in mpq to give a unique name without
-    // symbols
-    std::vector<unsigned char> hash(picosha2::k_digest_size);
+    std::vector<std::uint8_t> bytes(data.wpos());
+    data.rpos(0);
+    data.ReadBytes(bytes.data(), bytes.size());
 
-    auto const mpq_path_str = mpq_path.string();
-    std::vector<char> filename_vect;
-    std::copy(mpq_path_str.begin(), mpq_path_str.end(),
-              std::back_inserter(filename_vect));
-
-    picosha2::hash256(filename_vect, hash);
+    // compute sha256 checksum of the model data to give a name without
+    // symbols which is shared by all identical models
+    std::vector<unsigned char> hash(picosha2::k_digest_size);
+    picosha2::hash256(bytes, hash);
 
     std::stringstream str;
     for (auto const c : hash)
         str << std::hex << std::setw(2) << std::setfill('0') << (int)c;
 
-    return m_files[mpq_path.string()] = kind + "_" + str.str() + ".bvh";
+    auto const filename = kind + "_" + str.str() + ".bvh";
+
+    bool write;
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        auto const id = InternalAddFile(mpq_path);
+
+        m_models[id].second = filename;
+        write = m_files.insert(filename).second;
+
+        if (empty)
+            m_emptyModels.insert(id);
+    }
+
+    auto const path = m_outputPath / "BVH" / filename;
+
+    // a complete file of this name written by an earlier build has the same
+    // contents
+    if (!write ||
+        (fs::is_regular_file(path) && fs::file_size(path) == bytes.size()))
+        return;
+
+    std::ofstream of(path, std::ofstream::binary | std::ofstream::trunc);
+    of.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
 }
 
-fs::path BVHConstructor::AddFile(const fs::path& mpq_path)
+void BVHConstructor::AddTemporaryObstacle(std::uint32_t id,
+                                          const fs::path& mpq_path)
 {
     std::lock_guard<std::mutex> guard(m_mutex);
-    return m_outputPath / "BVH" / InternalAddFile(mpq_path);
+    m_temporaryObstacles[id] = InternalAddFile(mpq_path);
+}
+
+bool BVHConstructor::IsEmpty(const fs::path& mpq_path)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    auto const id = m_modelIds.find(mpq_path.string());
+
+    return id != m_modelIds.end() &&
+           m_emptyModels.find(id->second) != m_emptyModels.end();
+}
+
+bool BVHConstructor::IsWritten(const fs::path& mpq_path)
+{
+    std::string filename;
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        auto const id = m_modelIds.find(mpq_path.string());
+        if (id == m_modelIds.end())
+            return false;
+
+        filename = m_models[id->second].second;
+    }
+
+    return !filename.empty() &&
+           fs::is_regular_file(m_outputPath / "BVH" / filename);
 }
 
-fs::path BVHConstructor::AddTemporaryObstacle(std::uint32_t id,
-                                              const fs::path& mpq_path)
+std::uint32_t BVHConstructor::GetModelId(const fs::path& mpq_path)
 {
     std::lock_guard<std::mutex> guard(m_mutex);
-    return m_outputPath / "BVH" /
-           (m_temporaryObstacles[id] = InternalAddFile(mpq_path).string());
+    return InternalAddFile(mpq_path);
 }
 
 void BVHConstructor::Shutdown()
@@ -110,30 +183,62 @@ void BVHConstructor::Shutdown()
 
     std::lock_guard<std::mutex> guard(m_mutex);
 
-    utility::BinaryStream out;
+    std::string strings;
+    std::vector<bvhfiles::Model> models;
+    models.reserve(m_models.size());
 
-    // sort the final results because why not?
-    std::vector<std::pair<std::string, std::string>> serialized(m_files.begin(),
-                                                                m_files.end());
-    m_files.clear();
-    std::sort(serialized.begin(), serialized.end());
+    for (auto const& model : m_models)
+    {
+        bvhfiles::Model entry;
 
-    out << static_cast<std::uint32_t>(serialized.size()); // entry count
+        entry.mpqPathOffset = static_cast<std::uint32_t>(strings.size());
+        entry.mpqPathLength = static_cast<std::uint32_t>(model.first.size());
+        strings += model.first;
 
-    for (auto const& entry : serialized)
-        out << static_cast<std::uint32_t>(entry.first.length()) << entry.first
-            << static_cast<std::uint32_t>(entry.second.length())
-            << entry.second;
+        entry.bvhFileOffset = static_cast<std::uint32_t>(strings.size());
+        entry.bvhFileLength = static_cast<std::uint32_t>(model.second.size());
+        strings += model.second;
 
-    std::vector<std::pair<std::uint32_t, std::string>> obstacles(
-        m_temporaryObstacles.begin(), m_temporaryObstacles.end());
-    m_temporaryObstacles.clear();
-    std::sort(obstacles.begin(), obstacles.end());
+        models.push_back(entry);
+    }
 
-    out << static_cast<std::uint32_t>(obstacles.size());
-    for (auto const& entry : obstacles)
-        out << entry.first << static_cast<std::uint32_t>(entry.second.length())
-            << entry.second;
+    // sorted so that the runtime can binary search them
+    std::vector<bvhfiles::Obstacle> obstacles;
+    obstacles.reserve(m_temporaryObstacles.size());
+    for (auto const& obstacle : m_temporaryObstacles)
+        if (m_emptyModels.find(obstacle.second) == m_emptyModels.end())
+            obstacles.push_back({obstacle.first, obstacle.second});
+
+    std::sort(obstacles.begin(), obstacles.end(),
+              [](const bvhfiles::Obstacle& a, const bvhfiles::Obstacle& b) {
+                  return a.displayId < b.displayId;
+              });
+
+    bvhfiles::IndexHeader header;
+    header.signature = bvhfiles::IndexSignature;
+    header.version = bvhfiles::IndexVersion;
+    header.modelCount = static_cast<std::uint32_t>(models.size());
+    header.obstacleCount = static_cast<std::uint32_t>(obstacles.size());
+    header.stringsSize = static_cast<std::uint32_t>(strings.size());
+
+    utility::BinaryStream out(sizeof(header) +
+                              models.size() * sizeof(bvhfiles::Model) +
+                              obstacles.size() * sizeof(bvhfiles::Obstacle) +
+                              strings.size());
+
+    out << header;
+    if (!models.empty())
+        out.Write(&models[0], models.size() * sizeof(bvhfiles::Model));
+    if (!obstacles.empty())
+        out.Write(&obstacles[0], obstacles.size() * sizeof(bvhfiles::Obstacle));
+    out.Write(strings.data(), strings.size());
+
+    m_models.clear();
+    m_modelIds.clear();
+    m_claimedModels.clear();
+    m_files.clear();
+    m_emptyModels.clear();
+    m_temporaryObstacles.clear();
 
     std::ofstream o(m_outputPath / "BVH" / "bvh.idx",
                     std::ofstream::binary | std::ofstream::trunc);
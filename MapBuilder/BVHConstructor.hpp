@@ -1,40 +1,96 @@
 #pragma once
 
+#include "Common.hpp"
+#include "utility/BinaryStream.hpp"
+
 #include <atomic>
 #include <cstdint>
 #include <filesystem>
 #include <mutex>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 namespace fs = std::filesystem;
 
+// surface area heuristic costs of the trees written, summed over every model
+// with collision geometry
+struct SurfaceAreaCosts
+{
+    // as each tree was built, and as it was written after any optimization
+    float before = 0.f;
+    float after = 0.f;
+    size_t trees = 0;
+
+    void Add(const SurfaceAreaCosts& other)
+    {
+        before += other.before;
+        after += other.after;
+        trees += other.trees;
+    }
+
+    float AverageBefore() const { return trees ? before / trees : 0.f; }
+    float AverageAfter() const { return trees ? after / trees : 0.f; }
+};
+
 class BVHConstructor
 {
 private:
     const fs::path m_outputPath;
-    // this will track all serialized wmos and doodads and map to
-    // their .bvh path
-    std::unordered_map<std::string, std::string> m_files;
+
+    // this will track all serialized wmos and doodads as their mpq path and
+    // .bvh file name.  the index of a model is its id, which never changes
+    // once assigned so that ids stored in previously built maps stay valid
+    std::vector<std::pair<std::string, std::string>> m_models;
+    std::unordered_map<std::string, std::uint32_t> m_modelIds;
+
+    // models which have been, or are being, serialized by this process, and
+    // the .bvh files written for them.  files are named after their contents
+    // so that identical models found under different paths share one file
+    std::unordered_set<std::uint32_t> m_claimedModels;
+    std::unordered_set<std::string> m_files;
+
+    // models written without collision geometry.  these are never obstacles
+    std::unordered_set<std::uint32_t> m_emptyModels;
 
     // this will track those serialized wmos and doodads which
     // can be used as temporary obstacles because they have an id
-    // that can be referenced later.  maps to .bvh path.
-    std::unordered_map<int, std::string> m_temporaryObstacles;
+    // that can be referenced later.  maps to model id.
+    std::unordered_map<std::uint32_t, std::uint32_t> m_temporaryObstacles;
 
     std::atomic_bool m_shutdown;
 
     std::mutex m_mutex;
 
     // assumes the mutex has already been locked
-    fs::path InternalAddFile(const fs::path& mpq_path);
+    std::uint32_t InternalAddFile(const fs::path& mpq_path);
 
 public:
     BVHConstructor(const fs::path& outputPath);
     ~BVHConstructor();
 
-    fs::path AddFile(const fs::path& mpq_path);
-    fs::path AddTemporaryObstacle(std::uint32_t id, const fs::path& mpq_path);
+    // returns true if the caller is the first to ask, and should therefore
+    // serialize the model
+    bool Claim(const fs::path& mpq_path);
+
+    // stores the serialized model, unless identical data is already stored
+    void WriteModel(const fs::path& mpq_path, utility::BinaryStream& data,
+                    bool empty);
+
+    // true if the model was written without collision geometry.  this is
+    // only meaningful once every thread has finished writing models
+    bool IsEmpty(const fs::path& mpq_path);
+
+    // true if a .bvh file for the model, written by this or an earlier build,
+    // is present
+    bool IsWritten(const fs::path& mpq_path);
+
+    void AddTemporaryObstacle(std::uint32_t id, const fs::path& mpq_path);
+
+    // the id by which maps refer to the model
+    std::uint32_t GetModelId(const fs::path& mpq_path);
 
     void Shutdown();
-};
\ No newline at end of file
+};
@@ -0,0 +1,310 @@
+#include "BuildManifest.hpp"
+
+#include "Common.hpp"
+#include "parser/MpqManager.hpp"
+#include "utility/BinaryStream.hpp"
+#include "utility/PicoSHA2/picosha2.h"
+#include "utility/String.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+// reads the names from a chunk of null terminated strings, such as MMDX
+void ReadNames(utility::BinaryStream& file, const std::string& chunk,
+               std::vector<std::string>& names)
+{
+    size_t location;
+    if (!file.GetChunkLocation(chunk, location))
+        return;
+
+    file.rpos(location + 4);
+    auto const size = file.Read<std::uint32_t>();
+    auto const block = file.ReadString(size);
+
+    std::string name;
+    std::stringstream str(block);
+    while (std::getline(str, name, '\0'))
+        if (!name.empty())
+            names.push_back(name);
+}
+
+template <typename T>
+void Append(std::vector<std::uint8_t>& out, T value)
+{
+    auto const bytes = reinterpret_cast<const std::uint8_t*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+} // namespace
+
+BuildManifest::BuildManifest(const fs::path& path, const std::string& mapName)
+    : m_path(path), m_mapName(mapName)
+{
+    // any change to these invalidates every ADT
+    std::vector<std::uint8_t> settings;
+    Append(settings, MeshSettings::FileVersion);
+    Append(settings, MeshSettings::FileMap);
+    Append(settings, MeshSettings::TilesPerChunk);
+    Append(settings, MeshSettings::TileVoxelSize);
+    Append(settings, MeshSettings::CellHeight);
+    Append(settings, MeshSettings::WalkableHeight);
+    Append(settings, MeshSettings::WalkableRadius);
+    Append(settings, MeshSettings::WalkableSlope);
+    Append(settings, MeshSettings::WalkableClimb);
+    Append(settings, MeshSettings::DetailSampleDistance);
+    Append(settings, MeshSettings::DetailSampleMaxError);
+    Append(settings, MeshSettings::MaxSimplificationError);
+    Append(settings, MeshSettings::MinRegionSize);
+    Append(settings, MeshSettings::MergeRegionSize);
+    Append(settings, MeshSettings::VerticesPerPolygon);
+    Append(settings, bvhfiles::IndexVersion);
+    settings.insert(settings.end(), m_mapName.begin(), m_mapName.end());
+
+    picosha2::hash256(settings, m_settings);
+
+    // the WDT determines which ADTs exist, and for alpha data holds them all
+    if (!FileDigest("World\\Maps\\" + m_mapName + "\\" + m_mapName + ".wdt",
+                    m_wdt))
+        m_wdt.fill(0);
+
+    if (!fs::is_regular_file(m_path))
+        return;
+
+    utility::BinaryStream in(m_path);
+
+    std::uint32_t signature, version;
+    in >> signature >> version;
+
+    if (signature != manifestfiles::FileSignature ||
+        version != manifestfiles::FileVersion)
+        return;
+
+    manifestfiles::Digest settingsDigest;
+    in >> settingsDigest;
+
+    // a manifest for other settings is of no use
+    if (settingsDigest != m_settings)
+        return;
+
+    std::uint32_t count;
+    in >> count;
+
+    for (auto i = 0u; i < count; ++i)
+    {
+        std::int32_t x, y;
+        manifestfiles::Digest digest;
+        std::uint32_t modelCount;
+        in >> x >> y >> digest >> modelCount;
+
+        m_previous[{x, y}] = digest;
+
+        auto& models = m_previousModels[{x, y}];
+        models.reserve(modelCount);
+
+        for (auto m = 0u; m < modelCount; ++m)
+        {
+            std::uint32_t length;
+            in >> length;
+            models.push_back(in.ReadString(length));
+        }
+    }
+}
+
+bool BuildManifest::FileDigest(const std::string& mpqPath,
+                               manifestfiles::Digest& digest)
+{
+    auto const key = utility::lower(mpqPath);
+
+    auto const cached = m_files.find(key);
+    if (cached != m_files.end())
+    {
+        digest = cached->second;
+        return true;
+    }
+
+    auto file = parser::sMpqManager.OpenFile(key);
+
+    if (!file)
+        return false;
+
+    std::vector<std::uint8_t> bytes(file->wpos());
+    file->rpos(0);
+    if (!bytes.empty())
+        file->ReadBytes(&bytes[0], bytes.size());
+
+    picosha2::hash256_one_by_one hasher;
+    hasher.process(bytes.begin(), bytes.end());
+
+    std::vector<std::string> dependencies;
+    auto const extension = fs::path(key).extension().string();
+
+    if (extension == ".adt")
+    {
+        ReadNames(*file, "MMDX", dependencies);
+        ReadNames(*file, "MWMO", dependencies);
+    }
+    // a root wmo depends upon its group files and the doodads in its doodad
+    // sets.  group files have no MOHD chunk
+    else if (extension == ".wmo")
+    {
+        size_t mohdLocation;
+        if (file->GetChunkLocation("MOHD", mohdLocation))
+        {
+            file->rpos(mohdLocation + 8 + sizeof(std::uint32_t));
+            auto const groupCount = file->Read<std::int32_t>();
+
+            auto const stem = key.substr(0, key.rfind('.'));
+
+            for (auto i = 0; i < groupCount; ++i)
+            {
+                std::stringstream str;
+                str << stem << "_" << std::setfill('0') << std::setw(3) << i
+                    << ".wmo";
+                dependencies.push_back(str.str());
+            }
+
+            ReadNames(*file, "MODN", dependencies);
+        }
+    }
+
+    for (auto const& dependency : dependencies)
+    {
+        manifestfiles::Digest dependencyDigest;
+
+        // models which are missing are skipped when building too, so only
+        // their absence needs to be recorded
+        if (FileDigest(dependency, dependencyDigest))
+            hasher.process(dependencyDigest.begin(), dependencyDigest.end());
+        else
+            hasher.process(dependency.begin(), dependency.end());
+    }
+
+    hasher.finish();
+    hasher.get_hash_bytes(digest.begin(), digest.end());
+
+    m_files[key] = digest;
+
+    return true;
+}
+
+bool BuildManifest::AdtDigest(
+    const std::vector<std::pair<int, int>>& sourceAdts,
+    manifestfiles::Digest& digest)
+{
+    picosha2::hash256_one_by_one hasher;
+    hasher.process(m_settings.begin(), m_settings.end());
+    hasher.process(m_wdt.begin(), m_wdt.end());
+
+    auto sorted = sourceAdts;
+    std::sort(sorted.begin(), sorted.end());
+
+    for (auto const& adt : sorted)
+    {
+        std::stringstream str;
+        str << "World\\Maps\\" << m_mapName << "\\" << m_mapName << "_"
+            << adt.first << "_" << adt.second << ".adt";
+
+        manifestfiles::Digest adtDigest;
+        if (!FileDigest(str.str(), adtDigest))
+            return false;
+
+        std::vector<std::uint8_t> position;
+        Append(position, static_cast<std::int32_t>(adt.first));
+        Append(position, static_cast<std::int32_t>(adt.second));
+
+        hasher.process(position.begin(), position.end());
+        hasher.process(adtDigest.begin(), adtDigest.end());
+
+        auto const gameObjects = m_gameObjects.find(adt);
+        if (gameObjects != m_gameObjects.end())
+            hasher.process(gameObjects->second.begin(),
+                           gameObjects->second.end());
+    }
+
+    hasher.finish();
+    hasher.get_hash_bytes(digest.begin(), digest.end());
+
+    return true;
+}
+
+void BuildManifest::AddGameObject(int adtX, int adtY, std::uint32_t displayId,
+                                  const std::string& modelPath,
+                                  const float* position,
+                                  const float* quaternion)
+{
+    auto& out = m_gameObjects[{adtX, adtY}];
+
+    Append(out, displayId);
+
+    for (auto i = 0; i < 3; ++i)
+        Append(out, position[i]);
+
+    for (auto i = 0; i < 4; ++i)
+        Append(out, quaternion[i]);
+
+    // a model which cannot be read is recorded by name, as for those placed
+    // by ADTs
+    manifestfiles::Digest model;
+    if (FileDigest(modelPath, model))
+        out.insert(out.end(), model.begin(), model.end());
+    else
+        out.insert(out.end(), modelPath.begin(), modelPath.end());
+}
+
+bool BuildManifest::Unchanged(int adtX, int adtY,
+                              const manifestfiles::Digest& digest) const
+{
+    auto const i = m_previous.find({adtX, adtY});
+    return i != m_previous.end() && i->second == digest;
+}
+
+std::vector<std::string> BuildManifest::PreviousModels(int adtX,
+                                                       int adtY) const
+{
+    auto const i = m_previousModels.find({adtX, adtY});
+    return i == m_previousModels.end() ? std::vector<std::string>()
+                                       : i->second;
+}
+
+void BuildManifest::Record(int adtX, int adtY,
+                           const manifestfiles::Digest& digest,
+                           const std::vector<std::string>& models)
+{
+    m_current[{adtX, adtY}] = digest;
+    m_currentModels[{adtX, adtY}] = models;
+}
+
+void BuildManifest::Save() const
+{
+    utility::BinaryStream out(
+        sizeof(std::uint32_t) * 3 + sizeof(manifestfiles::Digest) +
+        m_current.size() * (sizeof(std::int32_t) * 2 +
+                            sizeof(manifestfiles::Digest) +
+                            sizeof(std::uint32_t)));
+
+    out << manifestfiles::FileSignature << manifestfiles::FileVersion
+        << m_settings << static_cast<std::uint32_t>(m_current.size());
+
+    for (auto const& entry : m_current)
+    {
+        auto const& models = m_currentModels.at(entry.first);
+
+        out << static_cast<std::int32_t>(entry.first.first)
+            << static_cast<std::int32_t>(entry.first.second) << entry.second
+            << static_cast<std::uint32_t>(models.size());
+
+        for (auto const& model : models)
+            out << static_cast<std::uint32_t>(model.length()) << model;
+    }
+
+    std::ofstream of(m_path, std::ofstream::binary | std::ofstream::trunc);
+    of << out;
+}
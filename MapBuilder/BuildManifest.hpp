@@ -0,0 +1,78 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace manifestfiles
+{
+static constexpr std::uint32_t FileSignature = 'MNFT';
+static constexpr std::uint32_t FileVersion = 2;
+
+using Digest = std::array<std::uint8_t, 32>;
+} // namespace manifestfiles
+
+// records a digest of the inputs from which each ADT of a map was built, so
+// that a later build may skip those ADTs whose inputs have not changed.  the
+// inputs of an ADT are the mesh settings, the map's WDT, and every ADT from
+// which its tiles draw chunks, along with the models which those ADTs place
+// and the game objects placed within them.  the models to which the tiles of
+// each ADT refer are also recorded, since the ADT is only usable while their
+// .bvh files remain
+class BuildManifest
+{
+private:
+    const std::filesystem::path m_path;
+    const std::string m_mapName;
+
+    manifestfiles::Digest m_settings;
+
+    // digests recorded by the previous build, and by this one
+    std::map<std::pair<int, int>, manifestfiles::Digest> m_previous;
+    std::map<std::pair<int, int>, manifestfiles::Digest> m_current;
+
+    // mpq paths of the models referred to by each ADT's tiles, as above
+    std::map<std::pair<int, int>, std::vector<std::string>> m_previousModels;
+    std::map<std::pair<int, int>, std::vector<std::string>> m_currentModels;
+
+    // digests of mpq files including their dependencies, which are shared by
+    // many ADTs
+    std::unordered_map<std::string, manifestfiles::Digest> m_files;
+    manifestfiles::Digest m_wdt;
+
+    // the game objects within each ADT, with the digests of their models
+    std::map<std::pair<int, int>, std::vector<std::uint8_t>> m_gameObjects;
+
+    bool FileDigest(const std::string& mpqPath, manifestfiles::Digest& digest);
+
+public:
+    BuildManifest(const std::filesystem::path& path,
+                  const std::string& mapName);
+
+    // false when one of the inputs cannot be read from its own file, as with
+    // alpha data.  such ADTs are always rebuilt
+    bool AdtDigest(const std::vector<std::pair<int, int>>& sourceAdts,
+                   manifestfiles::Digest& digest);
+
+    // adds a game object to the inputs of the ADT in which it lies.  these
+    // must all be added before the first call to AdtDigest
+    void AddGameObject(int adtX, int adtY, std::uint32_t displayId,
+                       const std::string& modelPath, const float* position,
+                       const float* quaternion);
+
+    bool Unchanged(int adtX, int adtY,
+                   const manifestfiles::Digest& digest) const;
+
+    // the models referred to by the ADT when the previous build recorded it
+    std::vector<std::string> PreviousModels(int adtX, int adtY) const;
+
+    void Record(int adtX, int adtY, const manifestfiles::Digest& digest,
+                const std::vector<std::string>& models);
+
+    void Save() const;
+};
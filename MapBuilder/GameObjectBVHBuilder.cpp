@@ -2,6 +2,7 @@
 
 #include "BVHConstructor.hpp"
 #include "MeshBuilder.hpp"
+#include "RecastContext.hpp"
 #include "parser/DBC.hpp"
 #include "parser/Doodad/Doodad.hpp"
 #include "parser/MpqManager.hpp"
@@ -10,6 +11,7 @@
 #include "utility/BinaryStream.hpp"
 #include "utility/Exception.hpp"
 
+#include <algorithm>
 #include <cstdint>
 #include <iostream>
 #include <mutex>
@@ -17,14 +19,19 @@
 #include <string>
 #include <thread>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace parser
 {
 GameObjectBVHBuilder::GameObjectBVHBuilder(const std::filesystem::path& dataPath,
                                            const std::filesystem::path& outputPath,
-                                           size_t workers)
+                                           size_t workers, bool optimize,
+                                           int logLevel)
     : m_dataPath(dataPath), m_bvhConstructor(outputPath), m_workers(workers),
-      m_shutdownRequested(false)
+      m_optimize(optimize),
+      m_verbose(logLevel == rcLogCategory::RC_LOG_PROGRESS),
+      m_pool(workers), m_shutdownRequested(false)
 {
     sMpqManager.Initialize(m_dataPath);
 
@@ -44,9 +51,9 @@ GameObjectBVHBuilder::GameObjectBVHBuilder(const std::filesystem::path& dataPath
         auto const extension = fs::path(path).extension().string();
 
         if (extension[1] == 'm' || extension[1] == 'M')
-            m_doodads[row] = path;
+            m_doodads[path].push_back(row);
         else if (extension[1] == 'w' || extension[1] == 'W')
-            m_wmos[row] = path;
+            m_wmos[path].push_back(row);
         else
             THROW(Result::UNRECOGNIZED_EXTENSION);
     }
@@ -59,12 +66,17 @@ GameObjectBVHBuilder::~GameObjectBVHBuilder()
 
 void GameObjectBVHBuilder::Begin()
 {
-    // if zero or one threads are requested, execute synchronously
+    // if zero or one threads are requested, execute synchronously.  the trees
+    // of large models are then built on every core
     if (m_workers <= 1)
+    {
+        m_pool.SetThreads(0);
         Work();
+    }
     else
-        for (auto i = 0u; i < m_workers; ++i)
-            m_threads.push_back(std::thread(&GameObjectBVHBuilder::Work, this));
+        m_threads.push_back(std::thread([this]() {
+            m_pool.Run(m_workers, [this](size_t) { Work(); });
+        }));
 }
 
 size_t GameObjectBVHBuilder::Shutdown()
@@ -75,13 +87,14 @@ size_t GameObjectBVHBuilder::Shutdown()
 
     m_threads.clear();
 
-    m_bvhConstructor.Shutdown();
-
+    // every model has now been written, so it is known which are empty
     size_t result = 0;
     for (auto const& entry : m_serialized)
-        if (entry.second != "")
+        if (!m_bvhConstructor.IsEmpty(entry.second))
             ++result;
 
+    m_bvhConstructor.Shutdown();
+
     return result;
 }
 
@@ -91,8 +104,8 @@ void GameObjectBVHBuilder::Work()
 
     while (!m_shutdownRequested)
     {
-        std::uint32_t entry;
         std::string filename;
+        std::vector<std::uint32_t> entries;
         bool isDoodad;
 
         {
@@ -108,8 +121,8 @@ void GameObjectBVHBuilder::Work()
             if (!m_wmos.empty())
             {
                 auto const i = m_wmos.begin();
-                entry = i->first;
-                filename = i->second;
+                filename = i->first;
+                entries = std::move(i->second);
                 m_wmos.erase(i);
                 isDoodad = false;
             }
@@ -118,8 +131,8 @@ void GameObjectBVHBuilder::Work()
             else
             {
                 auto const i = m_doodads.begin();
-                entry = i->first;
-                filename = i->second;
+                filename = i->first;
+                entries = std::move(i->second);
                 m_doodads.erase(i);
                 isDoodad = true;
             }
@@ -127,45 +140,40 @@ void GameObjectBVHBuilder::Work()
 
         try
         {
-            fs::path output;
-
-            if (isDoodad)
+            // doodads may already have been written as part of a wmo
+            auto const claimed = m_bvhConstructor.Claim(filename);
+            SurfaceAreaCosts costs;
+
+            // models with no collideable geometry are still written, as an
+            // empty tree, so that the index never names a model without its
+            // file.  the constructor leaves them out of the obstacles, whether
+            // they were written here or by another model
+            if (claimed && isDoodad)
             {
                 const parser::Doodad doodad(filename);
 
-                // ignore doodads with no collideable geometry
-                if (doodad.Vertices.empty() || doodad.Indices.empty())
-                {
-                    std::lock_guard<std::mutex> guard(m_mutex);
-                    m_serialized[entry] = "";
-                    continue;
-                }
-
-                output = m_bvhConstructor.AddTemporaryObstacle(entry, filename);
-                meshfiles::SerializeDoodad(doodad, output);
+                meshfiles::SerializeDoodad(doodad, m_bvhConstructor, costs,
+                                           m_optimize, &m_pool, m_verbose);
             }
-            else
+            else if (claimed)
             {
                 const parser::Wmo wmo(filename);
 
-                // ignore wmos with no collision geometry.  this probably
-                // shouldn't ever really happen
-                if (wmo.Vertices.empty() || wmo.Indices.empty())
-                {
-                    std::lock_guard<std::mutex> guard(m_mutex);
-                    m_serialized[entry] = "";
-                    continue;
-                }
-
-                output = m_bvhConstructor.AddTemporaryObstacle(entry, filename);
-
                 // note that this will also serialize all doodads referenced in
                 // all doodad sets within this wmo
-                meshfiles::SerializeWmo(wmo, m_bvhConstructor);
+                meshfiles::SerializeWmo(wmo, m_bvhConstructor, costs,
+                                        m_optimize, &m_pool, m_verbose);
             }
 
+            for (auto const entry : entries)
+                m_bvhConstructor.AddTemporaryObstacle(entry, filename);
+
             std::lock_guard<std::mutex> guard(m_mutex);
-            m_serialized[entry] = output.filename().string();
+
+            for (auto const entry : entries)
+                m_serialized[entry] = filename;
+
+            m_surfaceAreaCosts.Add(costs);
         }
         catch (utility::exception const& e)
         {
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "BVHConstructor.hpp"
+#include "utility/WorkerPool.hpp"
 
 #include <cstdint>
 #include <mutex>
@@ -19,12 +20,26 @@ private:
 
     BVHConstructor m_bvhConstructor;
     const size_t m_workers;
+    const bool m_optimize;
 
-    std::unordered_map<std::uint32_t, std::string> m_doodads;
-    std::unordered_map<std::uint32_t, std::string> m_wmos;
+    // log the costs of each tree
+    const bool m_verbose;
+
+    // models to build, each with every display id which refers to it
+    std::unordered_map<std::string, std::vector<std::uint32_t>> m_doodads;
+    std::unordered_map<std::string, std::vector<std::uint32_t>> m_wmos;
+
+    // mpq path of the model built for each display id
     std::unordered_map<std::uint32_t, std::string> m_serialized;
     std::vector<std::thread> m_threads;
 
+    // the workers run on this pool, which the trees of large models are also
+    // built on.  a worker which finds no models left helps to finish them
+    utility::WorkerPool m_pool;
+
+    // of all trees built
+    SurfaceAreaCosts m_surfaceAreaCosts;
+
     mutable std::mutex m_mutex;
 
     std::atomic_bool m_shutdownRequested;
@@ -33,7 +48,8 @@ private:
 
 public:
     GameObjectBVHBuilder(const std::filesystem::path& dataPath,
-                         const std::filesystem::path& outputPath, size_t workers);
+                         const std::filesystem::path& outputPath, size_t workers,
+                         bool optimize = false, int logLevel = 0);
     ~GameObjectBVHBuilder();
 
     void Begin();
@@ -44,5 +60,11 @@ public:
         std::lock_guard<std::mutex> guard(m_mutex);
         return m_doodads.size() + m_wmos.size();
     }
+
+    SurfaceAreaCosts GetSurfaceAreaCosts() const
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_surfaceAreaCosts;
+    }
 };
 } // namespace parser
\ No newline at end of file
@@ -0,0 +1,138 @@
+#include "InstanceCache.hpp"
+
+#include "Common.hpp"
+
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace
+{
+// an empty tree is left unbuilt, and has no triangles to return
+void BuildTree(math::AABBTree& tree, const std::vector<math::Vertex>& vertices,
+               const std::vector<int>& indices)
+{
+    if (!indices.empty())
+        tree.Build(vertices, indices);
+}
+} // namespace
+
+InstanceCache::InstanceCache(
+    const std::vector<std::atomic<int>>& adtReferences)
+    : m_adtReferences(adtReferences)
+{
+}
+
+std::shared_ptr<const InstanceGeometry>
+InstanceCache::Get(std::unordered_map<std::uint32_t, Entry>& entries,
+                   std::uint32_t id,
+                   const std::set<AdtChunkLocation>& adtChunks,
+                   const std::function<void(InstanceGeometry&)>& build)
+{
+    std::promise<std::shared_ptr<const InstanceGeometry>> promise;
+    std::shared_future<std::shared_ptr<const InstanceGeometry>> future;
+    bool load = false;
+
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        auto const i = entries.find(id);
+
+        if (i != entries.end())
+            future = i->second.geometry;
+        else
+        {
+            future = promise.get_future().share();
+
+            Entry entry;
+
+            // an ADT whose count has already reached zero may or may not have
+            // been released yet.  either way no pending tile will look for it
+            for (auto const& chunk : adtChunks)
+                if (m_adtReferences[chunk.AdtY * MeshSettings::Adts +
+                                    chunk.AdtX] > 0)
+                    entry.adts.insert({chunk.AdtX, chunk.AdtY});
+
+            if (!entry.adts.empty())
+            {
+                entry.geometry = future;
+                entries[id] = std::move(entry);
+            }
+
+            load = true;
+        }
+    }
+
+    // waiting for another thread to build the geometry
+    if (!load)
+        return future.get();
+
+    // large wmos take a while to transform, so the lock is not held
+    try
+    {
+        auto geometry = std::make_shared<InstanceGeometry>();
+        build(*geometry);
+        promise.set_value(std::move(geometry));
+    }
+    catch (...)
+    {
+        promise.set_exception(std::current_exception());
+        throw;
+    }
+
+    return future.get();
+}
+
+std::shared_ptr<const InstanceGeometry>
+InstanceCache::GetWmo(std::uint32_t id, const parser::WmoInstance& instance)
+{
+    return Get(m_wmos, id, instance.AdtChunks,
+               [&instance](InstanceGeometry& geometry) {
+                   std::vector<math::Vertex> vertices;
+                   std::vector<int> indices;
+
+                   instance.BuildTriangles(vertices, indices);
+                   BuildTree(geometry.mesh, vertices, indices);
+
+                   instance.BuildLiquidTriangles(vertices, indices);
+                   BuildTree(geometry.liquid, vertices, indices);
+
+                   instance.BuildDoodadTriangles(vertices, indices);
+                   BuildTree(geometry.doodads, vertices, indices);
+               });
+}
+
+std::shared_ptr<const InstanceGeometry>
+InstanceCache::GetDoodad(std::uint32_t id,
+                         const parser::DoodadInstance& instance)
+{
+    return Get(m_doodads, id, instance.AdtChunks,
+               [&instance](InstanceGeometry& geometry) {
+                   std::vector<math::Vertex> vertices;
+                   std::vector<int> indices;
+
+                   instance.BuildTriangles(vertices, indices);
+                   BuildTree(geometry.mesh, vertices, indices);
+               });
+}
+
+void InstanceCache::ReleaseAdt(int adtX, int adtY)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    // tiles still rasterizing an instance hold their own reference to it
+    for (auto entries : {&m_wmos, &m_doodads})
+        for (auto i = entries->begin(); i != entries->end();)
+        {
+            i->second.adts.erase({adtX, adtY});
+
+            if (i->second.adts.empty())
+                i = entries->erase(i);
+            else
+                ++i;
+        }
+}
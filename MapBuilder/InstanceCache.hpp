@@ -0,0 +1,67 @@
+#pragma once
+
+#include "parser/Adt/AdtChunkLocation.hpp"
+#include "parser/Doodad/DoodadInstance.hpp"
+#include "parser/Wmo/WmoInstance.hpp"
+#include "utility/AABBTree.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// world space geometry of one wmo or doodad instance, in trees so that each
+// tile need only take the triangles near to it.  doodads have only the solid
+// geometry
+struct InstanceGeometry
+{
+    math::AABBTree mesh;
+    math::AABBTree liquid;
+    math::AABBTree doodads;
+};
+
+// transformed instance geometry shared by every tile which the instance
+// overlaps.  an instance is only reachable through the chunks of the ADTs
+// listed in its AdtChunks, so its geometry is released once every one of
+// those ADTs is no longer needed by a pending tile
+class InstanceCache
+{
+private:
+    // the geometry is built by the first thread to ask for it, and any others
+    // wait for that to finish
+    struct Entry
+    {
+        std::shared_future<std::shared_ptr<const InstanceGeometry>> geometry;
+        std::set<std::pair<int, int>> adts;
+    };
+
+    // reference counts of each ADT by pending tiles, owned by the builder
+    const std::vector<std::atomic<int>>& m_adtReferences;
+
+    std::unordered_map<std::uint32_t, Entry> m_wmos;
+    std::unordered_map<std::uint32_t, Entry> m_doodads;
+
+    std::mutex m_mutex;
+
+    std::shared_ptr<const InstanceGeometry>
+    Get(std::unordered_map<std::uint32_t, Entry>& entries, std::uint32_t id,
+        const std::set<AdtChunkLocation>& adtChunks,
+        const std::function<void(InstanceGeometry&)>& build);
+
+public:
+    InstanceCache(const std::vector<std::atomic<int>>& adtReferences);
+
+    std::shared_ptr<const InstanceGeometry>
+    GetWmo(std::uint32_t id, const parser::WmoInstance& instance);
+    std::shared_ptr<const InstanceGeometry>
+    GetDoodad(std::uint32_t id, const parser::DoodadInstance& instance);
+
+    // called once no pending tile needs the given ADT
+    void ReleaseAdt(int adtX, int adtY);
+};
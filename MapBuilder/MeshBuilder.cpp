@@ -3,11 +3,13 @@
 #include "BVHConstructor.hpp"
 #include "Common.hpp"
 #include "FileExist.hpp"
+#include "PortalGraphBuilder.hpp"
 #include "RecastContext.hpp"
 #include "parser/Adt/Adt.hpp"
 #include "parser/Adt/AdtChunk.hpp"
 #include "parser/DBC.hpp"
 #include "recastnavigation/Detour/Include/DetourAlloc.h"
+#include "recastnavigation/Detour/Include/DetourNavMesh.h"
 #include "recastnavigation/Detour/Include/DetourNavMeshBuilder.h"
 #include "recastnavigation/Recast/Include/Recast.h"
 #include "utility/AABBTree.hpp"
@@ -99,6 +101,32 @@ void ComputeRequiredChunks(const parser::Map* map, int tileX, int tileY,
         }
 }
 
+// gathers the triangles of the tree which may overlap the box, along with only
+// those vertices which they use
+void ClipToBox(const math::AABBTree& tree, const math::BoundingBox& box,
+               std::vector<math::Vertex>& vertices, std::vector<int>& indices)
+{
+    vertices.clear();
+    indices.clear();
+
+    tree.IntersectBox(box, indices);
+
+    if (indices.empty())
+        return;
+
+    std::vector<int> used(indices);
+    std::sort(used.begin(), used.end());
+    used.erase(std::unique(used.begin(), used.end()), used.end());
+
+    vertices.reserve(used.size());
+    for (auto const i : used)
+        vertices.push_back(tree.Vertices()[i]);
+
+    for (auto& i : indices)
+        i = static_cast<int>(std::lower_bound(used.begin(), used.end(), i) -
+                             used.begin());
+}
+
 bool TransformAndRasterize(rcContext& ctx, rcHeightfield& heightField,
                            float slope,
                            const std::vector<math::Vertex>& vertices,
@@ -219,44 +247,74 @@ void SerializeWMOAndDoodadIDs(const std::unordered_set<std::uint32_t>& wmos,
     out = std::move(result);
 }
 
+void WriteVarInt(std::vector<std::uint8_t>& out, std::uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back(static_cast<std::uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+
+    out.push_back(static_cast<std::uint8_t>(value));
+}
+
 void SerializeHeightField(const rcHeightfield& solid,
                           utility::BinaryStream& out)
 {
-    utility::BinaryStream result(sizeof(std::uint32_t) *
-                                 (11 + 3 * (solid.width * solid.height)));
+    // a column begins with its span count.  an empty column is followed by the
+    // number of empty columns after it, which are not otherwise written.  each
+    // span is then written as the gap between its floor and the previous
+    // span's ceiling, followed by its height shifted left over its six bit
+    // area.  all of these are variable length integers
+    std::vector<std::uint8_t> spans;
+
+    auto const columns = solid.width * solid.height;
+    for (auto i = 0; i < columns;)
+    {
+        if (!solid.spans[i])
+        {
+            auto run = 1;
+            while (i + run < columns && !solid.spans[i + run])
+                ++run;
 
-    result << static_cast<std::int32_t>(solid.width)
-           << static_cast<std::int32_t>(solid.height);
+            WriteVarInt(spans, 0);
+            WriteVarInt(spans, static_cast<std::uint32_t>(run - 1));
 
-    result.Write(&solid.bmin, sizeof(solid.bmin));
-    result.Write(&solid.bmax, sizeof(solid.bmax));
+            i += run;
+            continue;
+        }
 
-    result << solid.cs << solid.ch;
+        std::uint32_t count = 0;
+        for (const rcSpan* s = solid.spans[i]; !!s; s = s->next)
+            ++count;
 
-    // TODO this might be storable in less space, since rcSpan is a bitfield
-    // struct
-    for (auto i = 0; i < solid.width * solid.height; ++i)
-    {
-        // place holder for the height of this column in the height field
-        auto const columnSize = result.wpos();
-        result << static_cast<std::uint32_t>(0);
+        WriteVarInt(spans, count);
 
-        auto count = 0;
+        std::uint32_t previous = 0;
         for (const rcSpan* s = solid.spans[i]; !!s; s = s->next)
         {
-            result << static_cast<std::uint32_t>(s->smin)
-                   << static_cast<std::uint32_t>(s->smax)
-                   << static_cast<std::uint32_t>(s->area);
-            ++count;
+            WriteVarInt(spans, s->smin - previous);
+            WriteVarInt(spans, ((s->smax - s->smin) << 6) | s->area);
+            previous = s->smax;
         }
 
-        auto const height =
-            (result.wpos() - columnSize + sizeof(std::uint32_t)) /
-            (3 * sizeof(std::uint32_t));
-
-        result.Write(columnSize, static_cast<std::uint32_t>(height));
+        ++i;
     }
 
+    utility::BinaryStream result(sizeof(std::uint32_t) * 11 + spans.size());
+
+    result << static_cast<std::int32_t>(solid.width)
+           << static_cast<std::int32_t>(solid.height);
+
+    result.Write(&solid.bmin, sizeof(solid.bmin));
+    result.Write(&solid.bmax, sizeof(solid.bmax));
+
+    result << solid.cs << solid.ch;
+
+    result << static_cast<std::uint32_t>(spans.size());
+    if (!spans.empty())
+        result.Write(&spans[0], spans.size());
+
     out = std::move(result);
 }
 
@@ -451,13 +509,109 @@ bool IsHeightFieldEmpty(rcHeightfield const& solid)
 
     return true;
 }
+
+// reads the detour tile data of every tile in a .nav file
+void ReadTileMeshes(
+    const fs::path& navFile,
+    std::map<std::pair<int, int>, std::vector<std::uint8_t>>& meshes)
+{
+    utility::BinaryStream in(navFile);
+    in.Decompress();
+
+    std::uint32_t signature, version, kind, adtX, adtY, tileCount;
+    in >> signature >> version >> kind >> adtX >> adtY >> tileCount;
+
+    if (signature != MeshSettings::FileSignature)
+        THROW(Result::INCORRECT_FILE_SIGNATURE);
+
+    if (version != MeshSettings::FileVersion)
+        THROW(Result::INCORRECT_FILE_VERSION);
+
+    for (auto i = 0u; i < tileCount; ++i)
+    {
+        std::uint32_t tileX, tileY, wmoCount, doodadCount;
+
+        in >> tileX >> tileY >> wmoCount;
+        in.rpos(in.rpos() + wmoCount * sizeof(std::uint32_t));
+
+        in >> doodadCount;
+        in.rpos(in.rpos() + doodadCount * sizeof(std::uint32_t));
+
+        std::uint8_t quadHeight;
+        in >> quadHeight;
+
+        // zone, area, holes and heights
+        if (quadHeight)
+        {
+            auto constexpr width = 8 / MeshSettings::TilesPerChunk;
+            in.rpos(in.rpos() + 2 * sizeof(std::uint32_t) + width * width +
+                    MeshSettings::QuadValuesPerTile * sizeof(float));
+        }
+
+        // height field header and spans
+        in.rpos(in.rpos() + 10 * sizeof(std::uint32_t));
+
+        std::uint32_t spansSize;
+        in >> spansSize;
+        in.rpos(in.rpos() + spansSize);
+
+        std::uint32_t meshSize;
+        in >> meshSize;
+
+        if (!meshSize)
+            continue;
+
+        auto& data =
+            meshes[{static_cast<int>(tileX), static_cast<int>(tileY)}];
+        data.resize(meshSize);
+        in.ReadBytes(&data[0], data.size());
+    }
+}
+
+void BuildTree(math::AABBTree& tree, const std::vector<math::Vertex>& vertices,
+               const std::vector<int>& indices, utility::WorkerPool* pool)
+{
+    if (pool)
+        tree.Build(vertices, indices, *pool);
+    else
+        tree.Build(vertices, indices);
+}
+
+// optimizes the tree if asked to, and adds its costs to the totals.  trees of
+// models without faces are not counted
+void OptimizeTree(math::AABBTree& tree, const std::string& mpqPath,
+                  SurfaceAreaCosts& costs, bool optimize, bool verbose)
+{
+    if (tree.Indices().empty())
+        return;
+
+    auto const before = tree.SurfaceAreaCost();
+
+    if (optimize)
+        tree.Optimize();
+
+    auto const after = optimize ? tree.SurfaceAreaCost() : before;
+
+    costs.before += before;
+    costs.after += after;
+    ++costs.trees;
+
+    if (verbose)
+    {
+        std::stringstream str;
+        str << "SAH cost of " << mpqPath << ": " << before << " -> " << after
+            << "\n";
+        std::cout << str.str();
+    }
+}
 } // namespace
 
 MeshBuilder::MeshBuilder(const std::filesystem::path& outputPath,
                          const std::string& mapName, int logLevel)
     : m_outputPath(outputPath), m_bvhConstructor(outputPath),
-      m_chunkReferences(MeshSettings::ChunkCount * MeshSettings::ChunkCount),
-      m_completedTiles(0), m_logLevel(logLevel)
+      m_adtReferences(MeshSettings::Adts * MeshSettings::Adts),
+      m_instanceCache(m_adtReferences),
+      m_optimizeBVH(false), m_completedTiles(0), m_logLevel(logLevel)
 {
     // this must follow the parser initialization
     m_map = std::make_unique<parser::Map>(mapName);
@@ -508,8 +662,8 @@ MeshBuilder::MeshBuilder(const std::filesystem::path& outputPath,
     }
     else
     {
-        // this build order should ensure that the tiles for one ADT finish
-        // before the next ADT begins (more or less)
+        // the order of this list does not matter, as the scheduler visits
+        // tiles in an order which keeps the loaded ADTs close together
         for (auto y = MeshSettings::Adts - 1; y >= 0; --y)
             for (auto x = MeshSettings::Adts - 1; x >= 0; --x)
             {
@@ -546,8 +700,9 @@ MeshBuilder::MeshBuilder(const std::filesystem::path& outputPath,
                          const std::string& mapName, int logLevel, int adtX,
                          int adtY)
     : m_outputPath(outputPath), m_bvhConstructor(outputPath),
-      m_chunkReferences(MeshSettings::ChunkCount * MeshSettings::ChunkCount),
-      m_completedTiles(0), m_logLevel(logLevel)
+      m_adtReferences(MeshSettings::Adts * MeshSettings::Adts),
+      m_instanceCache(m_adtReferences),
+      m_optimizeBVH(false), m_completedTiles(0), m_logLevel(logLevel)
 {
     // this must follow the parser initialization
     m_map = std::make_unique<parser::Map>(mapName);
@@ -573,6 +728,130 @@ MeshBuilder::MeshBuilder(const std::filesystem::path& outputPath,
     files::create_nav_output_directory_for_map(m_outputPath, mapName);
 }
 
+size_t MeshBuilder::UseManifest(bool incremental)
+{
+    // a global wmo is a single tile set built from one model, and is always
+    // rebuilt
+    if (IsGlobalWMO())
+        return 0;
+
+    m_manifest = std::make_unique<BuildManifest>(
+        m_outputPath / (m_map->Name + ".manifest"), m_map->Name);
+
+    if (!m_gameObjectInstances.empty())
+    {
+        auto const displayInfo =
+            parser::DBC("DBFilesClient\\GameObjectDisplayInfo.dbc");
+
+        std::unordered_map<std::uint32_t, std::string> modelPaths;
+        for (auto i = 0u; i < displayInfo.RecordCount(); ++i)
+            modelPaths[displayInfo.GetField(i, 0)] =
+                displayInfo.GetStringField(i, 1);
+
+        for (auto const& go : m_gameObjectInstances)
+        {
+            int adtX, adtY;
+            math::Convert::WorldToAdt(
+                {go.position[0], go.position[1], go.position[2]}, adtX, adtY);
+
+            m_manifest->AddGameObject(adtX, adtY, go.displayId,
+                                      modelPaths[go.displayId], go.position,
+                                      go.quaternion);
+        }
+    }
+
+    // the ADTs from which the tiles of each ADT draw their geometry
+    std::map<std::pair<int, int>, std::vector<std::pair<int, int>>> sourceAdts;
+
+    for (auto const& tile : m_pendingTiles)
+    {
+        auto& sources = sourceAdts[{tile.first / MeshSettings::TilesPerADT,
+                                    tile.second / MeshSettings::TilesPerADT}];
+
+        std::vector<std::pair<int, int>> chunks;
+        ComputeRequiredChunks(m_map.get(), tile.first, tile.second, chunks);
+
+        for (auto const& chunk : chunks)
+        {
+            std::pair<int, int> const adt {
+                chunk.first / MeshSettings::ChunksPerAdt,
+                chunk.second / MeshSettings::ChunksPerAdt};
+
+            if (std::find(sources.begin(), sources.end(), adt) ==
+                sources.end())
+                sources.push_back(adt);
+        }
+    }
+
+    for (auto const& adt : sourceAdts)
+    {
+        manifestfiles::Digest digest;
+
+        // the inputs could not be read, so there is nothing to compare or
+        // record
+        if (!m_manifest->AdtDigest(adt.second, digest))
+            continue;
+
+        if (!incremental ||
+            !m_manifest->Unchanged(adt.first.first, adt.first.second,
+                                   digest) ||
+            !fs::is_regular_file(AdtNavPath(adt.first.first, adt.first.second)))
+        {
+            m_adtDigests[adt.first] = digest;
+            continue;
+        }
+
+        // the tiles of the ADT are of no use without the models they refer to
+        auto const models =
+            m_manifest->PreviousModels(adt.first.first, adt.first.second);
+
+        if (std::all_of(models.cbegin(), models.cend(),
+                        [this](const std::string& model) {
+                            return m_bvhConstructor.IsWritten(model);
+                        }))
+        {
+            m_manifest->Record(adt.first.first, adt.first.second, digest,
+                               models);
+            m_skippedAdts.push_back(adt.first);
+        }
+        else
+            m_adtDigests[adt.first] = digest;
+    }
+
+    if (m_skippedAdts.empty())
+        return 0;
+
+    std::vector<std::pair<int, int>> pendingTiles;
+    pendingTiles.reserve(m_pendingTiles.size());
+
+    for (auto const& tile : m_pendingTiles)
+    {
+        std::pair<int, int> const adt {tile.first / MeshSettings::TilesPerADT,
+                                       tile.second / MeshSettings::TilesPerADT};
+
+        if (std::find(m_skippedAdts.begin(), m_skippedAdts.end(), adt) ==
+            m_skippedAdts.end())
+        {
+            pendingTiles.push_back(tile);
+            continue;
+        }
+
+        // no ADT has been loaded yet, so there is nothing to unload
+        std::vector<std::pair<int, int>> chunks;
+        ComputeRequiredChunks(m_map.get(), tile.first, tile.second, chunks);
+
+        for (auto const& chunk : chunks)
+            --m_adtReferences[(chunk.second / MeshSettings::ChunksPerAdt) *
+                                  MeshSettings::Adts +
+                              chunk.first / MeshSettings::ChunksPerAdt];
+    }
+
+    m_pendingTiles = std::move(pendingTiles);
+    m_totalTiles = m_pendingTiles.size();
+
+    return m_skippedAdts.size();
+}
+
 void MeshBuilder::LoadGameObjects(const std::string& path)
 {
     std::cout << "Reading game object..." << std::endl;
@@ -692,20 +971,20 @@ void MeshBuilder::LoadGameObjects(const std::string& path)
     }
 }
 
-bool MeshBuilder::GetNextTile(int& tileX, int& tileY)
+size_t MeshBuilder::AddWorker()
 {
     std::lock_guard<std::mutex> guard(m_mutex);
 
-    if (m_pendingTiles.empty())
-        return false;
+    if (!m_scheduler)
+        m_scheduler = std::make_unique<TileScheduler>(
+            m_pendingTiles, MeshSettings::TilesPerADT);
 
-    auto const back = m_pendingTiles.back();
-    m_pendingTiles.pop_back();
-
-    tileX = back.first;
-    tileY = back.second;
+    return m_scheduler->AddWorker();
+}
 
-    return true;
+bool MeshBuilder::GetNextTile(size_t worker, int& tileX, int& tileY)
+{
+    return m_scheduler->Next(worker, tileX, tileY);
 }
 
 bool MeshBuilder::IsGlobalWMO() const
@@ -717,7 +996,11 @@ void MeshBuilder::AddChunkReference(int chunkX, int chunkY)
 {
     assert(chunkX >= 0 && chunkY >= 0 && chunkX < MeshSettings::ChunkCount &&
            chunkY < MeshSettings::ChunkCount);
-    ++m_chunkReferences[chunkY * MeshSettings::ChunkCount + chunkX];
+
+    auto const adtX = chunkX / MeshSettings::ChunksPerAdt;
+    auto const adtY = chunkY / MeshSettings::ChunksPerAdt;
+
+    ++m_adtReferences[adtY * MeshSettings::Adts + adtX];
 }
 
 void MeshBuilder::RemoveChunkReference(int chunkX, int chunkY)
@@ -725,66 +1008,50 @@ void MeshBuilder::RemoveChunkReference(int chunkX, int chunkY)
     auto const adtX = chunkX / MeshSettings::ChunksPerAdt;
     auto const adtY = chunkY / MeshSettings::ChunksPerAdt;
 
-    std::lock_guard<std::mutex> guard(m_mutex);
-    --m_chunkReferences[chunkY * MeshSettings::ChunkCount + chunkX];
-
-    // check to see if all chunks on this ADT are without references.  if so,
-    // unload the ADT
-    bool unload = true;
-    for (int x = 0; x < MeshSettings::ChunksPerAdt; ++x)
-        for (int y = 0; y < MeshSettings::ChunksPerAdt; ++y)
-        {
-            auto const globalChunkX = adtX * MeshSettings::ChunksPerAdt + x;
-            auto const globalChunkY = adtY * MeshSettings::ChunksPerAdt + y;
-
-            if (m_chunkReferences[globalChunkY * MeshSettings::ChunkCount +
-                                  globalChunkX] > 0)
-            {
-                unload = false;
-                break;
-            }
-        }
+    // every reference is added before building begins, so once no tile needs
+    // this ADT, none ever will again
+    if (--m_adtReferences[adtY * MeshSettings::Adts + adtX] > 0)
+        return;
 
-    if (unload)
-    {
 #ifdef _DEBUG
-        std::stringstream str;
-        str << "No threads need ADT (" << std::setfill(' ') << std::setw(2)
-            << adtX << ", " << std::setfill(' ') << std::setw(2) << adtY
-            << ").  Unloading.\n";
-        std::cout << str.str();
+    std::stringstream str;
+    str << "No threads need ADT (" << std::setfill(' ') << std::setw(2) << adtX
+        << ", " << std::setfill(' ') << std::setw(2) << adtY
+        << ").  Unloading.\n";
+    std::cout << str.str();
 #endif
 
-        m_map->UnloadAdt(adtX, adtY);
-    }
+    m_instanceCache.ReleaseAdt(adtX, adtY);
+    m_map->UnloadAdt(adtX, adtY);
 }
 
 void MeshBuilder::SerializeWmo(const parser::Wmo& wmo)
 {
-    if (m_bvhWmos.find(wmo.MpqPath) != m_bvhWmos.end())
+    // the doodads of the wmo are claimed and serialized along with it
+    if (!m_bvhConstructor.Claim(wmo.MpqPath))
         return;
 
-    meshfiles::SerializeWmo(wmo, m_bvhConstructor);
+    SurfaceAreaCosts costs;
+    meshfiles::SerializeWmo(wmo, m_bvhConstructor, costs, m_optimizeBVH,
+                            nullptr,
+                            m_logLevel == rcLogCategory::RC_LOG_PROGRESS);
 
-    // the above serialization routine will also serialize all doodads in all
-    // doodad sets for this wmo, therefore we should mark them as serialized
-
-    for (auto const& doodadSet : wmo.DoodadSets)
-        for (auto const& wmoDoodad : doodadSet)
-            m_bvhDoodads.insert(wmoDoodad->Parent->MpqPath);
-
-    m_bvhWmos.insert(wmo.MpqPath);
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_surfaceAreaCosts.Add(costs);
 }
 
 void MeshBuilder::SerializeDoodad(const parser::Doodad& doodad)
 {
-    if (m_bvhDoodads.find(doodad.MpqPath) != m_bvhDoodads.end())
+    if (!m_bvhConstructor.Claim(doodad.MpqPath))
         return;
 
-    meshfiles::SerializeDoodad(doodad,
-                               m_bvhConstructor.AddFile(doodad.MpqPath));
+    SurfaceAreaCosts costs;
+    meshfiles::SerializeDoodad(doodad, m_bvhConstructor, costs, m_optimizeBVH,
+                               nullptr,
+                               m_logLevel == rcLogCategory::RC_LOG_PROGRESS);
 
-    m_bvhDoodads.insert(doodad.MpqPath);
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_surfaceAreaCosts.Add(costs);
 }
 
 bool MeshBuilder::BuildAndSerializeWMOTile(int tileX, int tileY)
@@ -964,6 +1231,12 @@ bool MeshBuilder::BuildAndSerializeMapTile(int tileX, int tileY)
     config.bmax[0] += config.borderSize * config.cs;
     config.bmax[2] += config.borderSize * config.cs;
 
+    // everything recast would rasterize into the height field, including the
+    // border, in wow coordinates
+    const math::BoundingBox clipBounds(
+        {-config.bmax[2], -config.bmax[0], config.bmin[1]},
+        {-config.bmin[2], -config.bmin[0], config.bmax[1]});
+
     RecastContext ctx(m_logLevel);
 
     SmartHeightFieldPtr solid(rcAllocHeightfield(), rcFreeHeightField);
@@ -972,6 +1245,10 @@ bool MeshBuilder::BuildAndSerializeMapTile(int tileX, int tileY)
                              config.bmin, config.bmax, config.cs, config.ch))
         return false;
 
+    // scratch space for the clipped instance geometry
+    std::vector<math::Vertex> vertices;
+    std::vector<int> indices;
+
     std::unordered_set<std::uint32_t> rasterizedWmos;
     std::unordered_set<std::uint32_t> rasterizedDoodads;
 
@@ -1016,21 +1293,20 @@ bool MeshBuilder::BuildAndSerializeMapTile(int tileX, int tileY)
             if (!tileBounds.intersect2d(wmoInstance->Bounds))
                 continue;
 
-            std::vector<math::Vertex> vertices;
-            std::vector<int> indices;
+            auto const geometry = m_instanceCache.GetWmo(wmoId, *wmoInstance);
 
-            wmoInstance->BuildTriangles(vertices, indices);
+            ClipToBox(geometry->mesh, clipBounds, vertices, indices);
             if (!TransformAndRasterize(ctx, *solid, config.walkableSlopeAngle,
                                        vertices, indices, PolyFlags::Wmo))
                 return false;
 
-            wmoInstance->BuildLiquidTriangles(vertices, indices);
+            ClipToBox(geometry->liquid, clipBounds, vertices, indices);
             if (!TransformAndRasterize(ctx, *solid, config.walkableSlopeAngle,
                                        vertices, indices,
                                        PolyFlags::Wmo | PolyFlags::Liquid))
                 return false;
 
-            wmoInstance->BuildDoodadTriangles(vertices, indices);
+            ClipToBox(geometry->doodads, clipBounds, vertices, indices);
             if (!TransformAndRasterize(ctx, *solid, config.walkableSlopeAngle,
                                        vertices, indices, PolyFlags::Doodad))
                 return false;
@@ -1051,10 +1327,10 @@ bool MeshBuilder::BuildAndSerializeMapTile(int tileX, int tileY)
             if (!tileBounds.intersect2d(doodadInstance->Bounds))
                 continue;
 
-            std::vector<math::Vertex> vertices;
-            std::vector<int> indices;
+            auto const geometry =
+                m_instanceCache.GetDoodad(doodadId, *doodadInstance);
 
-            doodadInstance->BuildTriangles(vertices, indices);
+            ClipToBox(geometry->mesh, clipBounds, vertices, indices);
             if (!TransformAndRasterize(ctx, *solid, config.walkableSlopeAngle,
                                        vertices, indices, PolyFlags::Doodad))
                 return false;
@@ -1088,17 +1364,13 @@ bool MeshBuilder::BuildAndSerializeMapTile(int tileX, int tileY)
     rcFilterWalkableLowHeightSpans(&ctx, config.walkableHeight, *solid);
     rcFilterLowHangingWalkableObstacles(&ctx, config.walkableClimb, *solid);
 
-    {
-        std::lock_guard<std::mutex> guard(m_mutex);
-
-        // Write the BVH for every new WMO
-        for (auto const& wmoId : rasterizedWmos)
-            SerializeWmo(*m_map->GetWmoInstance(wmoId)->Model);
+    // Write the BVH for every new WMO
+    for (auto const& wmoId : rasterizedWmos)
+        SerializeWmo(*m_map->GetWmoInstance(wmoId)->Model);
 
-        // Write the BVH for every new doodad
-        for (auto const& doodadId : rasterizedDoodads)
-            SerializeDoodad(*m_map->GetDoodadInstance(doodadId)->Model);
-    }
+    // Write the BVH for every new doodad
+    for (auto const& doodadId : rasterizedDoodads)
+        SerializeDoodad(*m_map->GetDoodadInstance(doodadId)->Model);
 
     // serialize WMO and doodad IDs for this tile
     utility::BinaryStream wmosAndDoodads;
@@ -1130,13 +1402,42 @@ bool MeshBuilder::BuildAndSerializeMapTile(int tileX, int tileY)
         adt->AddTile(localTileX, localTileY, wmosAndDoodads, quadHeightData,
                      heightFieldData, meshData);
 
+        if (m_manifest)
+        {
+            auto& models = m_adtModels[{adtX, adtY}];
+
+            for (auto const& wmoId : rasterizedWmos)
+            {
+                auto const& wmo = *m_map->GetWmoInstance(wmoId)->Model;
+                models.insert(wmo.MpqPath);
+
+                for (auto const& doodadSet : wmo.DoodadSets)
+                    for (auto const& wmoDoodad : doodadSet)
+                        models.insert(wmoDoodad->Parent->MpqPath);
+            }
+
+            for (auto const& doodadId : rasterizedDoodads)
+                models.insert(
+                    m_map->GetDoodadInstance(doodadId)->Model->MpqPath);
+        }
+
         if (adt->IsComplete())
         {
-            std::stringstream str;
-            str << std::setw(2) << std::setfill('0') << adtX << "_"
-                << std::setw(2) << std::setfill('0') << adtY << ".nav";
+            adt->Serialize(AdtNavPath(adtX, adtY));
+
+            if (m_manifest)
+            {
+                auto const digest = m_adtDigests.find({adtX, adtY});
+                auto const models = m_adtModels.find({adtX, adtY});
+
+                if (digest != m_adtDigests.end())
+                    m_manifest->Record(adtX, adtY, digest->second,
+                                       std::vector<std::string>(
+                                           models->second.cbegin(),
+                                           models->second.cend()));
 
-            adt->Serialize(m_outputPath / "Nav" / m_map->Name / str.str());
+                m_adtModels.erase(models);
+            }
 
 #ifdef _DEBUG
             std::stringstream log;
@@ -1156,18 +1457,123 @@ bool MeshBuilder::BuildAndSerializeMapTile(int tileX, int tileY)
     return result;
 }
 
-void MeshBuilder::SaveMap() const
+void MeshBuilder::SerializeNavigationGraph()
 {
+    // the tiles are read back from the files written for them, rather than
+    // kept in memory for the whole build.  this also takes in the ADTs of
+    // this map built by earlier runs
+    std::map<std::pair<int, int>, std::vector<std::uint8_t>> tileMeshes;
+
+    if (m_map->GetGlobalWmoInstance())
+    {
+        auto const navFile = m_outputPath / "Nav" / m_map->Name / "Map.nav";
+
+        if (fs::is_regular_file(navFile))
+            ReadTileMeshes(navFile, tileMeshes);
+    }
+    else
+    {
+        for (auto y = 0; y < MeshSettings::Adts; ++y)
+            for (auto x = 0; x < MeshSettings::Adts; ++x)
+            {
+                if (!m_map->HasAdt(x, y))
+                    continue;
+
+                auto const navFile = AdtNavPath(x, y);
+
+                if (fs::is_regular_file(navFile))
+                    ReadTileMeshes(navFile, tileMeshes);
+            }
+    }
+
+    if (tileMeshes.empty())
+        return;
+
+    // this must match the parameters used by pathfind::Map
+    dtNavMeshParams params;
+
+    if (auto const wmo = m_map->GetGlobalWmoInstance())
+    {
+        params.orig[0] = -wmo->Bounds.MaxCorner.Y;
+        params.orig[1] = wmo->Bounds.MinCorner.Z;
+        params.orig[2] = -wmo->Bounds.MaxCorner.X;
+    }
+    else
+    {
+        constexpr float mapOrigin = -32.f * MeshSettings::AdtSize;
+
+        params.orig[0] = mapOrigin;
+        params.orig[1] = 0.f;
+        params.orig[2] = mapOrigin;
+    }
+
+    params.tileHeight = params.tileWidth = MeshSettings::TileSize;
+    params.maxTiles = static_cast<int>(tileMeshes.size());
+    params.maxPolys = 1 << DT_POLY_BITS;
+
+    dtNavMesh navMesh;
+
+    if (navMesh.init(&params) != DT_SUCCESS)
+        THROW(Result::RECAST_FAILURE);
+
+    // detour links the tiles in place, so the buffers must outlive the nav
+    // mesh
+    for (auto& tile : tileMeshes)
+        if (navMesh.addTile(&tile.second[0],
+                            static_cast<int>(tile.second.size()), 0, 0,
+                            nullptr) != DT_SUCCESS)
+            THROW(Result::RECAST_FAILURE);
+
+    PortalGraphBuilder graph(navMesh);
+    graph.Build();
+
+    utility::BinaryStream out;
+    graph.Serialize(out);
+
+    std::ofstream of(m_outputPath / (m_map->Name + ".graph"),
+                     std::ofstream::binary | std::ofstream::trunc);
+    of << out;
+}
+
+fs::path MeshBuilder::AdtNavPath(int adtX, int adtY) const
+{
+    std::stringstream str;
+    str << std::setw(2) << std::setfill('0') << adtX << "_" << std::setw(2)
+        << std::setfill('0') << adtY << ".nav";
+
+    return m_outputPath / "Nav" / m_map->Name / str.str();
+}
+
+void MeshBuilder::SaveMap()
+{
+    // the map covers skipped ADTs too, so their instances are loaded
+    for (auto const& adt : m_skippedAdts)
+    {
+        m_map->GetAdt(adt.first, adt.second);
+        m_map->UnloadAdt(adt.first, adt.second);
+    }
+
     utility::BinaryStream out;
-    m_map->Serialize(out);
+    m_map->Serialize(out, [this](const std::string& mpqPath) {
+        return m_bvhConstructor.GetModelId(mpqPath);
+    });
 
     std::ofstream of(m_outputPath / (m_map->Name + ".map"),
                      std::ofstream::binary | std::ofstream::trunc);
     of << out;
+
+    SerializeNavigationGraph();
+
+    if (m_manifest)
+        m_manifest->Save();
 }
 
 float MeshBuilder::PercentComplete() const
 {
+    // every tile may have been skipped
+    if (!m_totalTiles)
+        return 100.f;
+
     return 100.f * (float(m_completedTiles) / float(m_totalTiles));
 }
 
@@ -1346,9 +1752,14 @@ void GlobalWMO::Serialize(const fs::path& filename) const
     out << outBuffer;
 }
 
-void SerializeWmo(const parser::Wmo& wmo, BVHConstructor& constructor)
+void SerializeWmo(const parser::Wmo& wmo, BVHConstructor& constructor,
+                  SurfaceAreaCosts& costs, bool optimize,
+                  utility::WorkerPool* pool, bool verbose)
 {
-    math::AABBTree aabbTree(wmo.Vertices, wmo.Indices);
+    math::AABBTree aabbTree;
+    BuildTree(aabbTree, wmo.Vertices, wmo.Indices, pool);
+
+    OptimizeTree(aabbTree, wmo.MpqPath, costs, optimize, verbose);
 
     utility::BinaryStream o;
     aabbTree.Serialize(o);
@@ -1371,29 +1782,31 @@ void SerializeWmo(const parser::Wmo& wmo, BVHConstructor& constructor)
 
             o << wmoDoodad->TransformMatrix;
             o << wmoDoodad->Bounds;
-            o.WriteString(doodad->MpqPath, MeshSettings::MaxMPQPathLength);
+            o << constructor.GetModelId(doodad->MpqPath);
 
-            // TODO: this probably causes the file to be written repeatedly
-            // also serialize this doodad
-            SerializeDoodad(*wmoDoodad->Parent.get(),
-                            constructor.AddFile(doodad->MpqPath));
+            // also serialize this doodad, unless that has already been done
+            if (constructor.Claim(doodad->MpqPath))
+                SerializeDoodad(*doodad, constructor, costs, optimize, pool,
+                                verbose);
         }
     }
 
-    auto const path = constructor.AddFile(wmo.MpqPath);
-
-    std::ofstream of(path, std::ofstream::binary | std::ofstream::trunc);
-    of << o;
+    constructor.WriteModel(wmo.MpqPath, o, wmo.Indices.empty());
 }
 
-void SerializeDoodad(const parser::Doodad& doodad, const fs::path& path)
+void SerializeDoodad(const parser::Doodad& doodad,
+                     BVHConstructor& constructor, SurfaceAreaCosts& costs,
+                     bool optimize, utility::WorkerPool* pool, bool verbose)
 {
-    math::AABBTree doodadTree(doodad.Vertices, doodad.Indices);
+    math::AABBTree doodadTree;
+    BuildTree(doodadTree, doodad.Vertices, doodad.Indices, pool);
+
+    OptimizeTree(doodadTree, doodad.MpqPath, costs, optimize, verbose);
 
     utility::BinaryStream doodadOut;
     doodadTree.Serialize(doodadOut);
 
-    std::ofstream of(path, std::ofstream::binary | std::ofstream::trunc);
-    of << doodadOut;
+    constructor.WriteModel(doodad.MpqPath, doodadOut,
+                           doodad.Indices.empty());
 }
 } // namespace meshfiles
\ No newline at end of file
@@ -1,18 +1,24 @@
 #pragma once
 
 #include "BVHConstructor.hpp"
+#include "BuildManifest.hpp"
 #include "Common.hpp"
+#include "InstanceCache.hpp"
+#include "TileScheduler.hpp"
 #include "parser/Map/Map.hpp"
 #include "parser/Wmo/Wmo.hpp"
 #include "utility/BinaryStream.hpp"
 #include "utility/Vector.hpp"
+#include "utility/WorkerPool.hpp"
 
+#include <atomic>
 #include <cstdint>
 #include <filesystem>
 #include <map>
+#include <memory>
 #include <mutex>
+#include <set>
 #include <string>
-#include <unordered_set>
 #include <vector>
 
 namespace meshfiles
@@ -78,9 +84,18 @@ public:
     void Serialize(const std::filesystem::path& filename) const override;
 };
 
-void SerializeWmo(const parser::Wmo& wmo, BVHConstructor& constructor);
+// these add the surface area heuristic costs of the trees written to costs,
+// including those of the doodads written along with a wmo.  the caller is
+// expected to have claimed the model from the constructor.  large trees are
+// built on the pool, if given.  if verbose, the costs of each tree are logged
+void SerializeWmo(const parser::Wmo& wmo, BVHConstructor& constructor,
+                  SurfaceAreaCosts& costs, bool optimize = false,
+                  utility::WorkerPool* pool = nullptr, bool verbose = false);
 void SerializeDoodad(const parser::Doodad& doodad,
-                     const std::filesystem::path& path);
+                     BVHConstructor& constructor, SurfaceAreaCosts& costs,
+                     bool optimize = false,
+                     utility::WorkerPool* pool = nullptr,
+                     bool verbose = false);
 } // namespace meshfiles
 
 class MeshBuilder
@@ -108,9 +123,14 @@ private:
     std::unique_ptr<meshfiles::GlobalWMO> m_globalWMO;
 
     std::vector<std::pair<int, int>> m_pendingTiles;
-    std::vector<int>
-        m_chunkReferences; // this is a fixed size, but it is so big that it can
-                           // single-handedly overflow the stack
+    std::unique_ptr<TileScheduler> m_scheduler;
+
+    // how many references remain to chunks of each ADT from tiles not yet
+    // built.  an ADT is unloaded when its count reaches zero
+    std::vector<std::atomic<int>> m_adtReferences;
+
+    // transformed wmo and doodad geometry, shared by the tiles they overlap
+    InstanceCache m_instanceCache;
 
     std::vector<math::Vertex> m_globalWMOVertices;
     std::vector<int> m_globalWMOIndices;
@@ -121,24 +141,42 @@ private:
     std::vector<math::Vertex> m_globalWMODoodadVertices;
     std::vector<int> m_globalWMODoodadIndices;
 
-    std::unordered_set<std::string> m_bvhWmos;
-    std::unordered_set<std::string> m_bvhDoodads;
+    bool m_optimizeBVH;
+
+    // of all trees built
+    SurfaceAreaCosts m_surfaceAreaCosts;
+
+    // inputs of the ADTs being built, and those ADTs which were skipped
+    // because their inputs are unchanged since the previous build
+    std::unique_ptr<BuildManifest> m_manifest;
+    std::map<std::pair<int, int>, manifestfiles::Digest> m_adtDigests;
+    std::vector<std::pair<int, int>> m_skippedAdts;
+
+    // mpq paths of the models to which the tiles built so far of each ADT in
+    // progress refer, including the doodads of their wmos
+    std::map<std::pair<int, int>, std::set<std::string>> m_adtModels;
 
     float m_minX, m_maxX, m_minY, m_maxY, m_minZ, m_maxZ;
 
     mutable std::mutex m_mutex;
 
     size_t m_totalTiles;
-    size_t m_completedTiles;
+    std::atomic<size_t> m_completedTiles;
 
     const int m_logLevel;
 
     void AddChunkReference(int chunkX, int chunkY);
     void RemoveChunkReference(int chunkX, int chunkY);
 
+    // the trees are built without the mutex, since claiming the model from
+    // the constructor keeps other threads from building it too
     void SerializeWmo(const parser::Wmo& wmo);
     void SerializeDoodad(const parser::Doodad& doodad);
 
+    void SerializeNavigationGraph();
+
+    std::filesystem::path AdtNavPath(int adtX, int adtY) const;
+
     // these two functions assume ownership of the mutex
     meshfiles::ADT* GetInProgressADT(int x, int y);
     void RemoveADT(const meshfiles::ADT* adt);
@@ -150,17 +188,33 @@ public:
                 int logLevel, int adtX, int adtY);
 
     void LoadGameObjects(const std::string& path);
+    void OptimizeBVH(bool optimize) { m_optimizeBVH = optimize; }
+
+    // records the inputs of every ADT in a manifest saved with the map.  if
+    // incremental, ADTs whose inputs match those recorded by the previous
+    // build are not rebuilt.  game objects are among the inputs, so they must
+    // be loaded first.  returns the number of ADTs skipped
+    size_t UseManifest(bool incremental);
 
     size_t CompletedTiles() const { return m_completedTiles; }
 
-    bool GetNextTile(int& tileX, int& tileY);
+    SurfaceAreaCosts GetSurfaceAreaCosts() const
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_surfaceAreaCosts;
+    }
+
+    // returns the index of the worker's tile queue.  the tiles to build are
+    // fixed once the first worker is added
+    size_t AddWorker();
+    bool GetNextTile(size_t worker, int& tileX, int& tileY);
 
     bool IsGlobalWMO() const;
 
     bool BuildAndSerializeWMOTile(int tileX, int tileY);
     bool BuildAndSerializeMapTile(int tileX, int tileY);
 
-    void SaveMap() const;
+    void SaveMap();
 
     float PercentComplete() const;
 };
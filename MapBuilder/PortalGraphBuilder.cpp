@@ -0,0 +1,416 @@
+#include "PortalGraphBuilder.hpp"
+
+#include "Common.hpp"
+#include "recastnavigation/Detour/Include/DetourCommon.h"
+#include "recastnavigation/Detour/Include/DetourNavMesh.h"
+#include "utility/BinaryStream.hpp"
+
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <map>
+#include <queue>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace
+{
+bool IsWalkable(const dtPoly* poly)
+{
+    return poly->flags != 0 && poly->getType() == DT_POLYTYPE_GROUND;
+}
+
+void PolyCenter(const dtMeshTile* tile, const dtPoly* poly, float* center)
+{
+    center[0] = center[1] = center[2] = 0.f;
+
+    for (auto i = 0; i < poly->vertCount; ++i)
+    {
+        auto const v = &tile->verts[poly->verts[i] * 3];
+        center[0] += v[0];
+        center[1] += v[1];
+        center[2] += v[2];
+    }
+
+    auto const s = 1.f / poly->vertCount;
+    center[0] *= s;
+    center[1] *= s;
+    center[2] *= s;
+}
+
+// labels polygons of the tile which are connected to one another without
+// leaving the tile
+std::vector<int> LabelTileRegions(const dtNavMesh& navMesh,
+                                  const dtMeshTile* tile)
+{
+    std::vector<int> labels(tile->header->polyCount, -1);
+    std::vector<int> stack;
+
+    auto region = 0;
+    for (auto i = 0; i < tile->header->polyCount; ++i)
+    {
+        if (labels[i] >= 0)
+            continue;
+
+        labels[i] = region;
+        stack.push_back(i);
+
+        while (!stack.empty())
+        {
+            auto const current = &tile->polys[stack.back()];
+            stack.pop_back();
+
+            for (auto l = current->firstLink; l != DT_NULL_LINK;
+                 l = tile->links[l].next)
+            {
+                const dtMeshTile* neighborTile;
+                const dtPoly* neighbor;
+                navMesh.getTileAndPolyByRefUnsafe(tile->links[l].ref,
+                                                  &neighborTile, &neighbor);
+
+                if (neighborTile != tile)
+                    continue;
+
+                auto const index = static_cast<int>(neighbor - tile->polys);
+
+                if (labels[index] >= 0)
+                    continue;
+
+                labels[index] = region;
+                stack.push_back(index);
+            }
+        }
+
+        ++region;
+    }
+
+    return labels;
+}
+} // namespace
+
+PortalGraphBuilder::PortalGraphBuilder(const dtNavMesh& navMesh)
+    : m_navMesh(navMesh), m_componentCount(0)
+{
+}
+
+dtPolyRef
+PortalGraphBuilder::GetPolyRef(const graphfiles::PolyLocation& location) const
+{
+    auto const tile = m_navMesh.getTileAt(location.tileX, location.tileY, 0);
+    assert(!!tile);
+
+    return m_navMesh.getPolyRefBase(tile) | location.poly;
+}
+
+void PortalGraphBuilder::Build()
+{
+    m_nodes.clear();
+    m_edges.clear();
+    m_components.clear();
+    m_componentCount = 0;
+
+    FindPortals();
+    ConnectPortals();
+    LabelComponents();
+}
+
+void PortalGraphBuilder::FindPortals()
+{
+    // (tile x, tile y, region, neighbor tile x, neighbor tile y) -> node
+    std::map<std::tuple<int, int, int, int, int>, std::uint32_t> entrances;
+
+    for (auto i = 0; i < m_navMesh.getMaxTiles(); ++i)
+    {
+        auto const tile = m_navMesh.getTile(i);
+
+        if (!tile->header)
+            continue;
+
+        auto const cluster =
+            graphfiles::ClusterId(tile->header->x, tile->header->y);
+
+        std::vector<int> regions;
+
+        for (auto p = 0; p < tile->header->polyCount; ++p)
+        {
+            auto const poly = &tile->polys[p];
+
+            if (!IsWalkable(poly))
+                continue;
+
+            for (auto l = poly->firstLink; l != DT_NULL_LINK;
+                 l = tile->links[l].next)
+            {
+                auto const& link = tile->links[l];
+
+                const dtMeshTile* neighborTile;
+                const dtPoly* neighbor;
+                m_navMesh.getTileAndPolyByRefUnsafe(link.ref, &neighborTile,
+                                                    &neighbor);
+
+                if (!IsWalkable(neighbor))
+                    continue;
+
+                auto const neighborCluster = graphfiles::ClusterId(
+                    neighborTile->header->x, neighborTile->header->y);
+
+                // every crossing is seen from both sides, so only record it
+                // from the side with the lower cluster id
+                if (neighborCluster <= cluster)
+                    continue;
+
+                if (regions.empty())
+                    regions = LabelTileRegions(m_navMesh, tile);
+
+                auto const key = std::make_tuple(
+                    tile->header->x, tile->header->y, regions[p],
+                    neighborTile->header->x, neighborTile->header->y);
+
+                if (entrances.find(key) != entrances.end())
+                    continue;
+
+                graphfiles::Node node;
+
+                // the portal is placed at the middle of the crossing edge
+                auto const va = &tile->verts[poly->verts[link.edge] * 3];
+                auto const vb =
+                    &tile->verts[poly->verts[(link.edge + 1) % poly->vertCount] *
+                                 3];
+                node.position[0] = (va[0] + vb[0]) * 0.5f;
+                node.position[1] = (va[1] + vb[1]) * 0.5f;
+                node.position[2] = (va[2] + vb[2]) * 0.5f;
+
+                node.clusters[0] = cluster;
+                node.clusters[1] = neighborCluster;
+
+                node.polys[0] = {tile->header->x, tile->header->y,
+                                 static_cast<std::uint32_t>(p)};
+                node.polys[1] = {
+                    neighborTile->header->x, neighborTile->header->y,
+                    static_cast<std::uint32_t>(neighbor - neighborTile->polys)};
+
+                entrances[key] = static_cast<std::uint32_t>(m_nodes.size());
+                m_nodes.push_back(node);
+            }
+        }
+    }
+}
+
+void PortalGraphBuilder::ConnectPortals()
+{
+    // (node, side) pairs for every cluster
+    std::unordered_map<std::uint32_t, std::vector<std::pair<std::uint32_t, int>>>
+        clusterNodes;
+
+    for (auto n = 0u; n < m_nodes.size(); ++n)
+        for (auto side = 0; side < 2; ++side)
+            clusterNodes[m_nodes[n].clusters[side]].push_back({n, side});
+
+    using QueueEntry = std::pair<float, dtPolyRef>;
+
+    for (auto const& cluster : clusterNodes)
+    {
+        auto const& nodes = cluster.second;
+
+        if (nodes.size() < 2)
+            continue;
+
+        // polygons through which the portals of this cluster are reached
+        std::unordered_map<dtPolyRef, std::vector<size_t>> targets;
+        for (auto i = 0u; i < nodes.size(); ++i)
+            targets[GetPolyRef(
+                        m_nodes[nodes[i].first].polys[nodes[i].second])]
+                .push_back(i);
+
+        // dijkstra from each portal over the polygons of this cluster,
+        // approximating the cost of movement by the distance between polygon
+        // centers
+        for (auto i = 0u; i < nodes.size(); ++i)
+        {
+            auto const& source = m_nodes[nodes[i].first];
+            auto const sourceRef = GetPolyRef(source.polys[nodes[i].second]);
+
+            std::unordered_map<dtPolyRef, float> cost;
+            std::priority_queue<QueueEntry, std::vector<QueueEntry>,
+                                std::greater<QueueEntry>>
+                open;
+
+            {
+                const dtMeshTile* tile;
+                const dtPoly* poly;
+                m_navMesh.getTileAndPolyByRefUnsafe(sourceRef, &tile, &poly);
+
+                float center[3];
+                PolyCenter(tile, poly, center);
+
+                cost[sourceRef] = dtVdist(source.position, center);
+                open.push({cost[sourceRef], sourceRef});
+            }
+
+            auto remaining = targets.size();
+
+            while (!open.empty() && remaining > 0)
+            {
+                auto const current = open.top();
+                open.pop();
+
+                if (current.first > cost[current.second])
+                    continue;
+
+                const dtMeshTile* tile;
+                const dtPoly* poly;
+                m_navMesh.getTileAndPolyByRefUnsafe(current.second, &tile,
+                                                    &poly);
+
+                float center[3];
+                PolyCenter(tile, poly, center);
+
+                auto const target = targets.find(current.second);
+                if (target != targets.end())
+                {
+                    --remaining;
+
+                    for (auto const j : target->second)
+                    {
+                        if (j == i)
+                            continue;
+
+                        auto const& destination = m_nodes[nodes[j].first];
+                        m_edges.push_back(
+                            {nodes[i].first, nodes[j].first,
+                             current.first +
+                                 dtVdist(center, destination.position)});
+                    }
+                }
+
+                for (auto l = poly->firstLink; l != DT_NULL_LINK;
+                     l = tile->links[l].next)
+                {
+                    auto const neighborRef = tile->links[l].ref;
+
+                    const dtMeshTile* neighborTile;
+                    const dtPoly* neighbor;
+                    m_navMesh.getTileAndPolyByRefUnsafe(
+                        neighborRef, &neighborTile, &neighbor);
+
+                    if (!IsWalkable(neighbor) ||
+                        graphfiles::ClusterId(neighborTile->header->x,
+                                              neighborTile->header->y) !=
+                            cluster.first)
+                        continue;
+
+                    float neighborCenter[3];
+                    PolyCenter(neighborTile, neighbor, neighborCenter);
+
+                    auto const neighborCost =
+                        current.first + dtVdist(center, neighborCenter);
+
+                    auto const existing = cost.find(neighborRef);
+                    if (existing != cost.end() &&
+                        existing->second <= neighborCost)
+                        continue;
+
+                    cost[neighborRef] = neighborCost;
+                    open.push({neighborCost, neighborRef});
+                }
+            }
+        }
+    }
+}
+
+void PortalGraphBuilder::LabelComponents()
+{
+    for (auto i = 0; i < m_navMesh.getMaxTiles(); ++i)
+    {
+        auto const tile = m_navMesh.getTile(i);
+
+        if (tile->header)
+            m_components[{tile->header->x, tile->header->y}].resize(
+                tile->header->polyCount, graphfiles::NoComponent);
+    }
+
+    std::vector<dtPolyRef> stack;
+
+    for (auto& tileComponents : m_components)
+    {
+        auto const tile = m_navMesh.getTileAt(tileComponents.first.first,
+                                              tileComponents.first.second, 0);
+
+        for (auto p = 0u; p < tileComponents.second.size(); ++p)
+        {
+            if (tileComponents.second[p] != graphfiles::NoComponent ||
+                !IsWalkable(&tile->polys[p]))
+                continue;
+
+            // flood fill across tile borders
+            auto const component = m_componentCount++;
+
+            tileComponents.second[p] = component;
+            stack.push_back(m_navMesh.getPolyRefBase(tile) | p);
+
+            while (!stack.empty())
+            {
+                const dtMeshTile* currentTile;
+                const dtPoly* current;
+                m_navMesh.getTileAndPolyByRefUnsafe(stack.back(), &currentTile,
+                                                    &current);
+                stack.pop_back();
+
+                for (auto l = current->firstLink; l != DT_NULL_LINK;
+                     l = currentTile->links[l].next)
+                {
+                    auto const neighborRef = currentTile->links[l].ref;
+
+                    const dtMeshTile* neighborTile;
+                    const dtPoly* neighbor;
+                    m_navMesh.getTileAndPolyByRefUnsafe(
+                        neighborRef, &neighborTile, &neighbor);
+
+                    if (!IsWalkable(neighbor))
+                        continue;
+
+                    auto& label = m_components[{neighborTile->header->x,
+                                                neighborTile->header->y}]
+                                              [neighbor - neighborTile->polys];
+
+                    if (label != graphfiles::NoComponent)
+                        continue;
+
+                    label = component;
+                    stack.push_back(neighborRef);
+                }
+            }
+        }
+    }
+}
+
+void PortalGraphBuilder::Serialize(utility::BinaryStream& out) const
+{
+    out << graphfiles::FileSignature << graphfiles::FileVersion;
+    out << static_cast<std::uint32_t>(graphfiles::TilesPerCluster);
+
+    out << static_cast<std::uint32_t>(m_nodes.size());
+    if (!m_nodes.empty())
+        out.Write(&m_nodes[0], m_nodes.size() * sizeof(graphfiles::Node));
+
+    out << static_cast<std::uint32_t>(m_edges.size());
+    if (!m_edges.empty())
+        out.Write(&m_edges[0], m_edges.size() * sizeof(graphfiles::Edge));
+
+    out << m_componentCount;
+    out << static_cast<std::uint32_t>(m_components.size());
+
+    for (auto const& tileComponents : m_components)
+    {
+        out << static_cast<std::int32_t>(tileComponents.first.first)
+            << static_cast<std::int32_t>(tileComponents.first.second)
+            << static_cast<std::uint32_t>(tileComponents.second.size());
+
+        if (!tileComponents.second.empty())
+            out.Write(&tileComponents.second[0],
+                      tileComponents.second.size() * sizeof(std::uint32_t));
+    }
+}
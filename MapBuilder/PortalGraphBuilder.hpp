@@ -0,0 +1,45 @@
+#pragma once
+
+#include "Common.hpp"
+#include "recastnavigation/Detour/Include/DetourNavMesh.h"
+#include "utility/BinaryStream.hpp"
+
+#include <cstdint>
+#include <map>
+#include <utility>
+#include <vector>
+
+// builds an abstract graph of the portals between clusters of tiles, with
+// edges weighted by the approximate cost of travelling between two portals of
+// the same cluster.  this is used to plan long paths before refining them.
+// the connected components of the mesh are also labeled, so that requests
+// for paths which cannot exist may be rejected immediately.
+class PortalGraphBuilder
+{
+private:
+    const dtNavMesh& m_navMesh;
+
+    std::vector<graphfiles::Node> m_nodes;
+    std::vector<graphfiles::Edge> m_edges;
+
+    // connected component id of every polygon, per tile
+    std::map<std::pair<int, int>, std::vector<std::uint32_t>> m_components;
+    std::uint32_t m_componentCount;
+
+    dtPolyRef GetPolyRef(const graphfiles::PolyLocation& location) const;
+
+    void FindPortals();
+    void ConnectPortals();
+    void LabelComponents();
+
+public:
+    PortalGraphBuilder(const dtNavMesh& navMesh);
+
+    void Build();
+
+    size_t NodeCount() const { return m_nodes.size(); }
+    size_t EdgeCount() const { return m_edges.size(); }
+    size_t ComponentCount() const { return m_componentCount; }
+
+    void Serialize(utility::BinaryStream& out) const;
+};
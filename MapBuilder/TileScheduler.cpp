@@ -0,0 +1,197 @@
+#include "TileScheduler.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <utility>
+#include <vector>
+
+namespace
+{
+// distance along a hilbert curve filling an n by n grid, where n is a power
+// of two
+std::uint64_t HilbertIndex(int n, int x, int y)
+{
+    std::uint64_t result = 0;
+
+    for (auto s = n / 2; s > 0; s /= 2)
+    {
+        auto const rx = (x & s) ? 1 : 0;
+        auto const ry = (y & s) ? 1 : 0;
+
+        result += static_cast<std::uint64_t>(s) * s * ((3 * rx) ^ ry);
+
+        if (!ry)
+        {
+            if (rx)
+            {
+                x = n - 1 - x;
+                y = n - 1 - y;
+            }
+
+            std::swap(x, y);
+        }
+    }
+
+    return result;
+}
+
+int NextPowerOfTwo(int value)
+{
+    auto result = 1;
+    while (result < value)
+        result *= 2;
+    return result;
+}
+} // namespace
+
+TileScheduler::TileScheduler(const std::vector<std::pair<int, int>>& tiles,
+                             int tilesPerBlock)
+    : m_nextBlock(0)
+{
+    assert(NextPowerOfTwo(tilesPerBlock) == tilesPerBlock);
+
+    std::map<std::pair<int, int>, std::vector<std::pair<int, int>>> blocks;
+
+    auto gridSize = 1;
+    for (auto const& tile : tiles)
+    {
+        std::pair<int, int> const block {tile.first / tilesPerBlock,
+                                         tile.second / tilesPerBlock};
+
+        blocks[block].push_back(tile);
+        gridSize = (std::max)(gridSize,
+                              (std::max)(block.first, block.second) + 1);
+    }
+
+    gridSize = NextPowerOfTwo(gridSize);
+
+    std::vector<std::pair<std::uint64_t, std::pair<int, int>>> order;
+    order.reserve(blocks.size());
+
+    for (auto const& block : blocks)
+        order.push_back({HilbertIndex(gridSize, block.first.first,
+                                      block.first.second),
+                         block.first});
+
+    std::sort(order.begin(), order.end());
+
+    m_blocks.reserve(order.size());
+
+    for (auto const& block : order)
+    {
+        auto& blockTiles = blocks[block.second];
+
+        std::sort(blockTiles.begin(), blockTiles.end(),
+                  [tilesPerBlock](const std::pair<int, int>& a,
+                                  const std::pair<int, int>& b) {
+                      return HilbertIndex(tilesPerBlock,
+                                          a.first % tilesPerBlock,
+                                          a.second % tilesPerBlock) <
+                             HilbertIndex(tilesPerBlock,
+                                          b.first % tilesPerBlock,
+                                          b.second % tilesPerBlock);
+                  });
+
+        m_blocks.push_back(std::move(blockTiles));
+    }
+}
+
+size_t TileScheduler::AddWorker()
+{
+    std::unique_lock<std::shared_mutex> guard(m_queuesMutex);
+
+    m_queues.push_back(std::make_unique<Queue>());
+    return m_queues.size() - 1;
+}
+
+bool TileScheduler::Next(size_t worker, int& tileX, int& tileY)
+{
+    Queue* queue;
+    {
+        std::shared_lock<std::shared_mutex> guard(m_queuesMutex);
+        queue = m_queues[worker].get();
+    }
+
+    for (;;)
+    {
+        {
+            std::lock_guard<std::mutex> guard(queue->mutex);
+
+            if (!queue->tiles.empty())
+            {
+                tileX = queue->tiles.front().first;
+                tileY = queue->tiles.front().second;
+                queue->tiles.pop_front();
+
+                return true;
+            }
+        }
+
+        auto const block = m_nextBlock++;
+
+        if (block < m_blocks.size())
+        {
+            std::lock_guard<std::mutex> guard(queue->mutex);
+            queue->tiles.assign(m_blocks[block].begin(),
+                                m_blocks[block].end());
+            continue;
+        }
+
+        if (!Steal(*queue))
+            return false;
+    }
+}
+
+bool TileScheduler::Steal(Queue& queue)
+{
+    std::shared_lock<std::shared_mutex> guard(m_queuesMutex);
+
+    for (;;)
+    {
+        Queue* victim = nullptr;
+        size_t victimSize = 0;
+
+        for (auto const& q : m_queues)
+        {
+            if (q.get() == &queue)
+                continue;
+
+            std::lock_guard<std::mutex> queueGuard(q->mutex);
+
+            if (q->tiles.size() > victimSize)
+            {
+                victim = q.get();
+                victimSize = q->tiles.size();
+            }
+        }
+
+        if (!victim)
+            return false;
+
+        // the tiles at the back of the victim's queue are those it would
+        // reach last.  only one queue is locked at a time
+        std::vector<std::pair<int, int>> stolen;
+        {
+            std::lock_guard<std::mutex> victimGuard(victim->mutex);
+
+            auto const count = (victim->tiles.size() + 1) / 2;
+            auto const start = victim->tiles.end() - count;
+
+            stolen.assign(start, victim->tiles.end());
+            victim->tiles.erase(start, victim->tiles.end());
+        }
+
+        // the victim emptied its queue in the meantime
+        if (stolen.empty())
+            continue;
+
+        std::lock_guard<std::mutex> queueGuard(queue.mutex);
+        queue.tiles.insert(queue.tiles.end(), stolen.begin(), stolen.end());
+
+        return true;
+    }
+}
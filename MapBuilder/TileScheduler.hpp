@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <utility>
+#include <vector>
+
+// hands out tiles to worker threads.  tiles are grouped into blocks the size
+// of an ADT, and the blocks, as well as the tiles within them, are visited
+// along a hilbert curve.  each worker claims one block at a time into its own
+// queue so that the tiles being built at any moment share as many chunks (and
+// therefore loaded ADTs) as possible.  once every block has been claimed,
+// idle workers steal half of the remaining tiles from the busiest worker
+class TileScheduler
+{
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<std::pair<int, int>> tiles;
+    };
+
+    std::vector<std::vector<std::pair<int, int>>> m_blocks;
+    std::atomic<size_t> m_nextBlock;
+
+    // the queues are only added to while workers are starting
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    mutable std::shared_mutex m_queuesMutex;
+
+    bool Steal(Queue& queue);
+
+public:
+    TileScheduler(const std::vector<std::pair<int, int>>& tiles,
+                  int tilesPerBlock);
+
+    // returns the index of a new queue for the calling worker
+    size_t AddWorker();
+
+    bool Next(size_t worker, int& tileX, int& tileY);
+};
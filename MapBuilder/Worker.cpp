@@ -17,6 +17,7 @@
 Worker::Worker(const std::string& dataPath, MeshBuilder* meshBuilder)
     : m_dataPath(dataPath), m_meshBuilder(meshBuilder),
       m_shutdownRequested(false), m_wmo(meshBuilder->IsGlobalWMO()),
+      m_queue(meshBuilder->AddWorker()),
       m_isFinished(false), m_thread(&Worker::Work, this)
 {
 }
@@ -36,7 +37,7 @@ void Worker::Work()
         do
         {
             int tileX, tileY;
-            if (!m_meshBuilder->GetNextTile(tileX, tileY))
+            if (!m_meshBuilder->GetNextTile(m_queue, tileX, tileY))
                 break;
 
             if (m_wmo)
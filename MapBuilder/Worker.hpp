@@ -15,6 +15,7 @@ private:
     MeshBuilder* const m_meshBuilder;
 
     const bool m_wmo;
+    const size_t m_queue;
     bool m_shutdownRequested;
     std::atomic_bool m_isFinished;
 
@@ -2,6 +2,7 @@
 #include "MeshBuilder.hpp"
 #include "Worker.hpp"
 #include "parser/Adt/Adt.hpp"
+#include "parser/GeometryCache.hpp"
 #include "parser/MpqManager.hpp"
 #include "parser/Wmo/WmoInstance.hpp"
 #include "utility/String.hpp"
@@ -30,10 +31,18 @@ void DisplayUsage(std::ostream& o)
     o << "  -m/--map <map name>            -- Which map to produce data for\n";
     o << "  -b/--bvh                       -- Build line of sight (BVH) data "
          "for all models eligible for spawning by the server\n";
+    o << "  --optimize-bvh                 -- Spend extra time optimizing "
+         "line of sight (BVH) data\n";
+    o << "  --incremental                  -- Only rebuild ADTs whose input "
+         "files have changed since the previous build\n";
     o << "  -g/--gocsv <go csv file>       -- Path to CSV file containing game "
          "object data to include in static mesh output\n";
     o << "  -o/--output <output directory> -- Path to root output directory\n";
     o << "  -t/--threads <thread count>    -- How many worker threads to use\n";
+    o << "  --mpq-cache <megabytes>        -- Memory to keep extracted files "
+         "in for reuse (default 256, 0 = disabled)\n";
+    o << "  --geometry-cache <directory>   -- Path to directory in which to "
+         "keep parsed geometry for later builds\n";
     o << "  -l/--logLevel <log level>      -- Log level (0 = none, 1 = "
          "progress, 2 = warning, 3 = error)\n";
 #ifdef _DEBUG
@@ -48,9 +57,10 @@ void DisplayUsage(std::ostream& o)
 
 int main(int argc, char* argv[])
 {
-    std::string dataPath, map, outputPath, goCSVPath;
-    int adtX = -1, adtY = -1, threads = 1, logLevel;
-    bool bvh = false;
+    std::string dataPath, map, outputPath, goCSVPath, geometryCachePath;
+    int adtX = -1, adtY = -1, threads = 1, logLevel = 0,
+        mpqCache = 256;
+    bool bvh = false, optimizeBVH = false, incremental = false;
 
     try
     {
@@ -64,6 +74,16 @@ int main(int argc, char* argv[])
                 bvh = true;
                 continue;
             }
+            else if (arg == "--optimize-bvh")
+            {
+                optimizeBVH = true;
+                continue;
+            }
+            else if (arg == "--incremental")
+            {
+                incremental = true;
+                continue;
+            }
             else if (arg == "-h" || arg == "--help")
             {
                 // when this is requested, don't do anything else
@@ -86,6 +106,10 @@ int main(int argc, char* argv[])
                 outputPath = argv[++i];
             else if (arg == "-t" || arg == "--threads")
                 threads = std::stoi(argv[++i]);
+            else if (arg == "--mpq-cache")
+                mpqCache = std::stoi(argv[++i]);
+            else if (arg == "--geometry-cache")
+                geometryCachePath = argv[++i];
             else if (arg == "-l" || arg == "--loglevel")
                 logLevel = std::stoi(argv[++i]);
 #ifdef _DEBUG
@@ -129,6 +153,16 @@ int main(int argc, char* argv[])
         return EXIT_FAILURE;
     }
 
+    if (mpqCache < 0)
+    {
+        std::cerr << "ERROR: Invalid MPQ cache size " << mpqCache << std::endl;
+        DisplayUsage(std::cerr);
+        return EXIT_FAILURE;
+    }
+
+    parser::sMpqManager.SetCacheCapacity(static_cast<size_t>(mpqCache) * 1024 *
+                                         1024);
+
     auto lastStatus = static_cast<time_t>(0);
 
     std::unique_ptr<MeshBuilder> builder;
@@ -138,6 +172,8 @@ int main(int argc, char* argv[])
     {
         files::create_bvh_output_directory(outputPath);
 
+        parser::sGeometryCache.Initialize(geometryCachePath);
+
         if (bvh)
         {
             if (!goCSVPath.empty())
@@ -150,7 +186,8 @@ int main(int argc, char* argv[])
             }
 
             parser::GameObjectBVHBuilder goBuilder(dataPath, outputPath,
-                                                   threads);
+                                                   threads, optimizeBVH,
+                                                   logLevel);
 
             auto const startSize = goBuilder.Remaining();
 
@@ -190,8 +227,15 @@ int main(int argc, char* argv[])
 
             goBuilder.Shutdown();
 
+            auto const costs = goBuilder.GetSurfaceAreaCosts();
+
             std::stringstream fin;
-            fin << "Finished BVH generation";
+            fin << "Finished BVH generation.  Average SAH cost: ";
+            if (optimizeBVH)
+                fin << costs.AverageBefore() << " before optimization, "
+                    << costs.AverageAfter() << " after";
+            else
+                fin << costs.AverageAfter();
             std::cout << fin.str() << std::endl;
 
             return EXIT_SUCCESS;
@@ -199,8 +243,8 @@ int main(int argc, char* argv[])
 
         files::create_nav_output_directory(outputPath);
 
-        // nav mesh generation requires that the MPQ manager be initialized for
-        // the main thread, whereas BVH generation above does not.
+        // the MPQ manager is shared by all threads, and the workers started
+        // below find it already initialized
 
         parser::sMpqManager.Initialize(dataPath);
 
@@ -209,6 +253,8 @@ int main(int argc, char* argv[])
             builder = std::make_unique<MeshBuilder>(outputPath, map, logLevel,
                                                     adtX, adtY);
 
+            builder->OptimizeBVH(optimizeBVH);
+
             if (!goCSVPath.empty())
                 builder->LoadGameObjects(goCSVPath);
 
@@ -236,9 +282,16 @@ int main(int argc, char* argv[])
         {
             builder = std::make_unique<MeshBuilder>(outputPath, map, logLevel);
 
+            builder->OptimizeBVH(optimizeBVH);
+
+            // the game objects are part of the inputs recorded by the manifest
             if (!goCSVPath.empty())
                 builder->LoadGameObjects(goCSVPath);
 
+            if (auto const skipped = builder->UseManifest(incremental))
+                std::cout << "Skipping " << skipped << " unchanged ADTs"
+                          << std::endl;
+
             for (auto i = 0; i < threads; ++i)
                 workers.push_back(
                     std::make_unique<Worker>(dataPath, builder.get()));
@@ -288,5 +341,13 @@ int main(int argc, char* argv[])
     std::cout << "Finished " << map << " (" << builder->CompletedTiles()
               << " tiles) in " << runTime << " seconds." << std::endl;
 
+    if (optimizeBVH)
+    {
+        auto const costs = builder->GetSurfaceAreaCosts();
+        std::cout << "Average SAH cost: " << costs.AverageBefore()
+                  << " before optimization, " << costs.AverageAfter()
+                  << " after" << std::endl;
+    }
+
     return EXIT_SUCCESS;
 }
\ No newline at end of file
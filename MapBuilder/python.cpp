@@ -35,7 +35,7 @@ int BuildBVH(const std::string& dataPath, const std::string& outputPath,
 
 bool BuildMap(const std::string& dataPath, const std::string& outputPath,
               const std::string& mapName, size_t threads,
-              const std::string& goCSV)
+              const std::string& goCSV, bool incremental)
 {
     if (!threads)
         return false;
@@ -55,6 +55,8 @@ bool BuildMap(const std::string& dataPath, const std::string& outputPath,
         if (!goCSV.empty())
             builder->LoadGameObjects(goCSV);
 
+        builder->UseManifest(incremental);
+
         for (auto i = 0u; i < threads; ++i)
             workers.push_back(
                 std::make_unique<Worker>(dataPath, builder.get()));
@@ -147,12 +149,15 @@ PYBIND11_MODULE(mapbuild, m)
     );
     m.def("build_map",
         &BuildMap,
-        "Builds a specific map. `build_bvh` must be called before this function.",
+        R"del(Builds a specific map. `build_bvh` must be called before this function.
+
+If `incremental`, ADTs whose inputs are unchanged since the previous build are not rebuilt.)del",
         py::arg("data_path"),
         py::arg("output_path"),
         py::arg("map_name"),
         py::arg("threads"),
-        py::arg("go_csv")
+        py::arg("go_csv"),
+        py::arg("incremental") = false
     );
     m.def("build_adt",
          &BuildADT,
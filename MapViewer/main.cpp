@@ -264,6 +264,7 @@ LRESULT CALLBACK GuiWindowProc(HWND hWnd, UINT message, WPARAM wParam,
                     gNavMesh->AddGameObject(
                         gMouseDoodad->Guid, gMouseDoodad->DisplayId,
                         gMouseDoodad->Position, gMouseDoodad->Rotation);
+                    gNavMesh->UpdateObstacles(-1);
                     gMouseDoodad.reset();
 
                     DetourDebugDraw dd(gRenderer.get());
@@ -15,6 +15,7 @@
 #include "Adt/Chunks/MWMO.hpp"
 #include "Common.hpp"
 #include "Doodad/DoodadPlacement.hpp"
+#include "GeometryCache.hpp"
 #include "Map/Map.hpp"
 #include "MpqManager.hpp"
 #include "utility/Vector.hpp"
@@ -93,29 +94,6 @@ Adt::Adt(Map* map, int adtX, int adtY)
 
     const input::MHDR header(mhdrLocation, reader.get(), map->m_isAlphaData);
 
-    std::unique_ptr<input::MH2O> liquidChunk(
-        header.Mh2oOffset ?
-            new input::MH2O(header.Mh2oOffset, reader.get()) :
-            nullptr);
-
-    size_t currMcnk;
-    if (!reader->GetChunkLocation("MCNK", mhdrLocation, currMcnk))
-        THROW(Result::NO_MCNK_CHUNK);
-
-    std::unique_ptr<input::MCNK> chunks[16][16];
-
-    bool hasMclq = false;
-    for (int y = 0; y < 16; ++y)
-        for (int x = 0; x < 16; ++x)
-        {
-            chunks[y][x] = std::make_unique<input::MCNK>(
-                currMcnk, reader.get(), map->m_isAlphaData, adtX, adtY);
-            currMcnk += 8 + chunks[y][x]->Size;
-
-            if (chunks[y][x]->HasWater)
-                hasMclq = true;
-        }
-
     std::vector<std::string> doodadNames;
     std::vector<std::string> wmoNames;
 
@@ -156,6 +134,179 @@ Adt::Adt(Map* map, int adtX, int adtY)
             new input::MODF(modfLocation, reader.get()) :
             nullptr);
 
+    // alpha ADTs are a part of the WDT, which is already in memory
+    auto const useCache = sGeometryCache.Enabled() && !map->m_isAlphaData;
+
+    geometrycachefiles::Digest digest;
+    std::unique_ptr<utility::BinaryStream> cached;
+
+    if (useCache)
+    {
+        digest = GeometryCache::Hash(geometrycachefiles::Adt, {reader.get()});
+        cached = sGeometryCache.Load(geometrycachefiles::Adt, digest);
+    }
+
+    if (cached)
+        ReadTerrain(*cached);
+    else
+    {
+        ParseTerrain(reader.get(), header.Mh2oOffset, mhdrLocation,
+                     map->m_isAlphaData);
+
+        if (useCache)
+        {
+            utility::BinaryStream entry;
+            WriteTerrain(entry);
+            sGeometryCache.Save(geometrycachefiles::Adt, digest, entry);
+        }
+    }
+
+    // WMOs
+
+    if (wmoChunk)
+        for (auto const& wmoDefinition : wmoChunk->Wmos)
+        {
+            std::string wmoName;
+            if (map->m_isAlphaData)
+            {
+                assert(wmoDefinition.NameId < map->m_wmoNames.size());
+                wmoName = map->m_wmoNames[wmoDefinition.NameId];
+            }
+            else
+            {
+                assert(wmoDefinition.NameId < wmoNames.size());
+                wmoName = wmoNames[wmoDefinition.NameId];
+            }
+
+            auto const wmo = map->GetWmo(wmoName);
+            const WmoInstance* wmoInstance;
+
+            // ensure that the instance has been loaded
+            if ((wmoInstance = map->GetWmoInstance(static_cast<unsigned int>(
+                     wmoDefinition.UniqueId))) == nullptr)
+            {
+                math::BoundingBox bounds;
+                wmoDefinition.GetBoundingBox(bounds);
+
+                math::Matrix transformMatrix;
+                wmoDefinition.GetTransformMatrix(transformMatrix);
+
+                wmoInstance = new WmoInstance(wmo, wmoDefinition.DoodadSet,
+                                              wmoDefinition.NameSet, bounds,
+                                              transformMatrix);
+                map->InsertWmoInstance(wmoDefinition.UniqueId, wmoInstance);
+            }
+
+            assert(!!wmo && !!wmoInstance);
+
+            for (auto const& chunk : wmoInstance->AdtChunks)
+            {
+                if (chunk.AdtX != X || chunk.AdtY != Y)
+                    continue;
+
+                m_chunks[chunk.ChunkY][chunk.ChunkX]->m_wmoInstances.push_back(
+                    wmoDefinition.UniqueId);
+                m_chunks[chunk.ChunkY][chunk.ChunkX]->m_minZ =
+                    std::min(m_chunks[chunk.ChunkY][chunk.ChunkX]->m_minZ,
+                             wmoInstance->Bounds.MinCorner.Z);
+                m_chunks[chunk.ChunkY][chunk.ChunkX]->m_maxZ =
+                    std::max(m_chunks[chunk.ChunkY][chunk.ChunkX]->m_maxZ,
+                             wmoInstance->Bounds.MaxCorner.Z);
+            }
+
+            Bounds.MinCorner.Z =
+                std::min(Bounds.MinCorner.Z, wmoInstance->Bounds.MinCorner.Z);
+            Bounds.MaxCorner.Z =
+                std::max(Bounds.MaxCorner.Z, wmoInstance->Bounds.MaxCorner.Z);
+        }
+
+    // Doodads
+
+    if (doodadChunk)
+        for (auto const& doodadDefinition : doodadChunk->Doodads)
+        {
+            std::string doodadName;
+            if (map->m_isAlphaData)
+            {
+                assert(doodadDefinition.NameId < m_map->m_doodadNames.size());
+                doodadName = m_map->m_doodadNames[doodadDefinition.NameId];
+            }
+            else
+            {
+                assert(doodadDefinition.NameId < doodadNames.size());
+                doodadName = doodadNames[doodadDefinition.NameId];
+            }
+
+            auto const doodad = map->GetDoodad(doodadName);
+
+            // skip those doodads which have no collision geometry
+            if (!doodad->Vertices.size() || !doodad->Indices.size())
+                continue;
+
+            const DoodadInstance* doodadInstance;
+
+            // ensure that the instance has been loaded
+            if ((doodadInstance = map->GetDoodadInstance(
+                     static_cast<unsigned int>(doodadDefinition.UniqueId))) ==
+                nullptr)
+            {
+                math::Matrix transformMatrix;
+                doodadDefinition.GetTransformMatrix(transformMatrix);
+
+                doodadInstance = new DoodadInstance(doodad, transformMatrix);
+                map->InsertDoodadInstance(
+                    static_cast<unsigned int>(doodadDefinition.UniqueId),
+                    doodadInstance);
+            }
+
+            assert(!!doodad && !!doodadInstance);
+
+            for (auto const& chunk : doodadInstance->AdtChunks)
+            {
+                if (chunk.AdtX != X || chunk.AdtY != Y)
+                    continue;
+
+                m_chunks[chunk.ChunkY][chunk.ChunkX]
+                    ->m_doodadInstances.push_back(doodadDefinition.UniqueId);
+                m_chunks[chunk.ChunkY][chunk.ChunkX]->m_minZ =
+                    std::min(m_chunks[chunk.ChunkY][chunk.ChunkX]->m_minZ,
+                             doodadInstance->Bounds.MinCorner.Z);
+                m_chunks[chunk.ChunkY][chunk.ChunkX]->m_maxZ =
+                    std::max(m_chunks[chunk.ChunkY][chunk.ChunkX]->m_maxZ,
+                             doodadInstance->Bounds.MaxCorner.Z);
+            }
+
+            Bounds.MinCorner.Z = std::min(Bounds.MinCorner.Z,
+                                          doodadInstance->Bounds.MinCorner.Z);
+            Bounds.MaxCorner.Z = std::max(Bounds.MaxCorner.Z,
+                                          doodadInstance->Bounds.MaxCorner.Z);
+        }
+}
+
+void Adt::ParseTerrain(utility::BinaryStream* reader, size_t mh2oOffset,
+                       size_t mhdrLocation, bool alpha)
+{
+    std::unique_ptr<input::MH2O> liquidChunk(
+        mh2oOffset ? new input::MH2O(mh2oOffset, reader) : nullptr);
+
+    size_t currMcnk;
+    if (!reader->GetChunkLocation("MCNK", mhdrLocation, currMcnk))
+        THROW(Result::NO_MCNK_CHUNK);
+
+    std::unique_ptr<input::MCNK> chunks[16][16];
+
+    bool hasMclq = false;
+    for (int y = 0; y < 16; ++y)
+        for (int x = 0; x < 16; ++x)
+        {
+            chunks[y][x] = std::make_unique<input::MCNK>(currMcnk, reader,
+                                                         alpha, X, Y);
+            currMcnk += 8 + chunks[y][x]->Size;
+
+            if (chunks[y][x]->HasWater)
+                hasMclq = true;
+        }
+
     // Process all data into triangles/indices
     // Terrain
 
@@ -420,126 +571,49 @@ Adt::Adt(Map* map, int adtX, int adtY)
                                 chunk->m_liquidVertices.size() - 3));
                     }
             }
+}
 
-    // WMOs
-
-    if (wmoChunk)
-        for (auto const& wmoDefinition : wmoChunk->Wmos)
+// the cached terrain of each chunk, before the instances placed on it are
+// added.  zone ids are looked up again, as they come from the DBCs
+void Adt::WriteTerrain(utility::BinaryStream& stream) const
+{
+    for (int chunkY = 0; chunkY < 16; ++chunkY)
+        for (int chunkX = 0; chunkX < 16; ++chunkX)
         {
-            std::string wmoName;
-            if (map->m_isAlphaData)
-            {
-                assert(wmoDefinition.NameId < map->m_wmoNames.size());
-                wmoName = map->m_wmoNames[wmoDefinition.NameId];
-            }
-            else
-            {
-                assert(wmoDefinition.NameId < wmoNames.size());
-                wmoName = wmoNames[wmoDefinition.NameId];
-            }
-
-            auto const wmo = map->GetWmo(wmoName);
-            const WmoInstance* wmoInstance;
-
-            // ensure that the instance has been loaded
-            if ((wmoInstance = map->GetWmoInstance(static_cast<unsigned int>(
-                     wmoDefinition.UniqueId))) == nullptr)
-            {
-                math::BoundingBox bounds;
-                wmoDefinition.GetBoundingBox(bounds);
-
-                math::Matrix transformMatrix;
-                wmoDefinition.GetTransformMatrix(transformMatrix);
-
-                wmoInstance = new WmoInstance(wmo, wmoDefinition.DoodadSet,
-                                              wmoDefinition.NameSet, bounds,
-                                              transformMatrix);
-                map->InsertWmoInstance(wmoDefinition.UniqueId, wmoInstance);
-            }
-
-            assert(!!wmo && !!wmoInstance);
-
-            for (auto const& chunk : wmoInstance->AdtChunks)
-            {
-                if (chunk.AdtX != X || chunk.AdtY != Y)
-                    continue;
-
-                m_chunks[chunk.ChunkY][chunk.ChunkX]->m_wmoInstances.push_back(
-                    wmoDefinition.UniqueId);
-                m_chunks[chunk.ChunkY][chunk.ChunkX]->m_minZ =
-                    std::min(m_chunks[chunk.ChunkY][chunk.ChunkX]->m_minZ,
-                             wmoInstance->Bounds.MinCorner.Z);
-                m_chunks[chunk.ChunkY][chunk.ChunkX]->m_maxZ =
-                    std::max(m_chunks[chunk.ChunkY][chunk.ChunkX]->m_maxZ,
-                             wmoInstance->Bounds.MaxCorner.Z);
-            }
-
-            Bounds.MinCorner.Z =
-                std::min(Bounds.MinCorner.Z, wmoInstance->Bounds.MinCorner.Z);
-            Bounds.MaxCorner.Z =
-                std::max(Bounds.MaxCorner.Z, wmoInstance->Bounds.MaxCorner.Z);
+            auto const chunk = m_chunks[chunkY][chunkX].get();
+
+            stream.Write(chunk->m_holeMap, sizeof(chunk->m_holeMap));
+            stream.Write(chunk->m_heights, sizeof(chunk->m_heights));
+            WriteArray(stream, chunk->m_terrainVertices);
+            WriteArray(stream, chunk->m_terrainIndices);
+            WriteArray(stream, chunk->m_liquidVertices);
+            WriteArray(stream, chunk->m_liquidIndices);
+            stream << chunk->m_areaId << chunk->m_minZ << chunk->m_maxZ;
         }
+}
 
-    // Doodads
-
-    if (doodadChunk)
-        for (auto const& doodadDefinition : doodadChunk->Doodads)
+void Adt::ReadTerrain(utility::BinaryStream& stream)
+{
+    for (int chunkY = 0; chunkY < 16; ++chunkY)
+        for (int chunkX = 0; chunkX < 16; ++chunkX)
         {
-            std::string doodadName;
-            if (map->m_isAlphaData)
-            {
-                assert(doodadDefinition.NameId < m_map->m_doodadNames.size());
-                doodadName = m_map->m_doodadNames[doodadDefinition.NameId];
-            }
-            else
-            {
-                assert(doodadDefinition.NameId < doodadNames.size());
-                doodadName = doodadNames[doodadDefinition.NameId];
-            }
+            auto chunk = std::make_unique<AdtChunk>();
 
-            auto const doodad = map->GetDoodad(doodadName);
-
-            // skip those doodads which have no collision geometry
-            if (!doodad->Vertices.size() || !doodad->Indices.size())
-                continue;
+            stream.ReadBytes(chunk->m_holeMap, sizeof(chunk->m_holeMap));
+            stream.ReadBytes(chunk->m_heights, sizeof(chunk->m_heights));
+            ReadArray(stream, chunk->m_terrainVertices);
+            ReadArray(stream, chunk->m_terrainIndices);
+            ReadArray(stream, chunk->m_liquidVertices);
+            ReadArray(stream, chunk->m_liquidIndices);
+            stream >> chunk->m_areaId >> chunk->m_minZ >> chunk->m_maxZ;
 
-            const DoodadInstance* doodadInstance;
-
-            // ensure that the instance has been loaded
-            if ((doodadInstance = map->GetDoodadInstance(
-                     static_cast<unsigned int>(doodadDefinition.UniqueId))) ==
-                nullptr)
-            {
-                math::Matrix transformMatrix;
-                doodadDefinition.GetTransformMatrix(transformMatrix);
-
-                doodadInstance = new DoodadInstance(doodad, transformMatrix);
-                map->InsertDoodadInstance(
-                    static_cast<unsigned int>(doodadDefinition.UniqueId),
-                    doodadInstance);
-            }
-
-            assert(!!doodad && !!doodadInstance);
-
-            for (auto const& chunk : doodadInstance->AdtChunks)
-            {
-                if (chunk.AdtX != X || chunk.AdtY != Y)
-                    continue;
+            chunk->m_zoneId = sMpqManager.GetZoneId(chunk->m_areaId);
 
-                m_chunks[chunk.ChunkY][chunk.ChunkX]
-                    ->m_doodadInstances.push_back(doodadDefinition.UniqueId);
-                m_chunks[chunk.ChunkY][chunk.ChunkX]->m_minZ =
-                    std::min(m_chunks[chunk.ChunkY][chunk.ChunkX]->m_minZ,
-                             doodadInstance->Bounds.MinCorner.Z);
-                m_chunks[chunk.ChunkY][chunk.ChunkX]->m_maxZ =
-                    std::max(m_chunks[chunk.ChunkY][chunk.ChunkX]->m_maxZ,
-                             doodadInstance->Bounds.MaxCorner.Z);
-            }
+            // each chunk's height range already covers its terrain and liquid
+            Bounds.MinCorner.Z = std::min(Bounds.MinCorner.Z, chunk->m_minZ);
+            Bounds.MaxCorner.Z = std::max(Bounds.MaxCorner.Z, chunk->m_maxZ);
 
-            Bounds.MinCorner.Z = std::min(Bounds.MinCorner.Z,
-                                          doodadInstance->Bounds.MinCorner.Z);
-            Bounds.MaxCorner.Z = std::max(Bounds.MaxCorner.Z,
-                                          doodadInstance->Bounds.MaxCorner.Z);
+            m_chunks[chunkY][chunkX] = std::move(chunk);
         }
 }
 
@@ -2,6 +2,7 @@
 
 #include "parser/Doodad/DoodadInstance.hpp"
 #include "parser/Wmo/WmoInstance.hpp"
+#include "utility/BinaryStream.hpp"
 #include "utility/BoundingBox.hpp"
 
 #include <cstdint>
@@ -41,6 +42,14 @@ private:
     std::unique_ptr<AdtChunk> m_chunks[16][16];
     Map* const m_map;
 
+    // fills in the terrain and liquid of every chunk, and the height of the
+    // bounds which they cover
+    void ParseTerrain(utility::BinaryStream* reader, size_t mh2oOffset,
+                      size_t mhdrLocation, bool alpha);
+
+    void WriteTerrain(utility::BinaryStream& stream) const;
+    void ReadTerrain(utility::BinaryStream& stream);
+
 public:
     const int X;
     const int Y;
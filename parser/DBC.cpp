@@ -32,8 +32,18 @@ DBC::DBC(const std::string& filename)
     if (!in)
         THROW_MSG("Failed to open DBC " + filename, Result::FAILED_TO_OPEN_DBC);
 
+    Load(*in);
+}
+
+DBC::DBC(utility::BinaryStream& in)
+{
+    Load(in);
+}
+
+void DBC::Load(utility::BinaryStream& in)
+{
     dbc_header header;
-    *in >> header;
+    in >> header;
 
     if (header.magic != Magic)
         THROW(Result::UNRECOGNIZED_DBC_FILE);
@@ -44,12 +54,12 @@ DBC::DBC(const std::string& filename)
     m_fieldCount = header.field_count;
 
     m_data.resize(header.record_count * header.field_count);
-    in->ReadBytes(&m_data[0], m_data.size() * sizeof(std::uint32_t));
+    in.ReadBytes(&m_data[0], m_data.size() * sizeof(std::uint32_t));
 
     // ensure that we have precisely enough space left for the string block
-    assert(header.string_block_size + in->rpos() == in->wpos());
+    assert(header.string_block_size + in.rpos() == in.wpos());
     m_string.resize(header.string_block_size);
-    in->ReadBytes(&m_string[0], m_string.size());
+    in.ReadBytes(&m_string[0], m_string.size());
 }
 
 std::uint32_t DBC::GetField(int row, int column) const
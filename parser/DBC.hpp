@@ -1,5 +1,7 @@
 #pragma once
 
+#include "utility/BinaryStream.hpp"
+
 #include <cstdint>
 #include <string>
 #include <vector>
@@ -17,8 +19,11 @@ private:
     size_t m_recordCount;
     size_t m_fieldCount;
 
+    void Load(utility::BinaryStream& in);
+
 public:
     DBC(const std::string& filename);
+    DBC(utility::BinaryStream& in);
 
     std::uint32_t GetField(int row, int column) const;
     std::string GetStringField(int row, int column) const;
@@ -1,5 +1,6 @@
 #include "Doodad/Doodad.hpp"
 
+#include "GeometryCache.hpp"
 #include "MpqManager.hpp"
 #include "utility/BinaryStream.hpp"
 #include "utility/Exception.hpp"
@@ -23,6 +24,35 @@ Doodad::Doodad(const std::string& path) : MpqPath(utility::lower(path))
         return;
     }
 
+    if (!sGeometryCache.Enabled())
+    {
+        Parse(reader.get());
+        return;
+    }
+
+    auto const digest =
+        GeometryCache::Hash(geometrycachefiles::Doodad, {reader.get()});
+
+    if (auto cached = sGeometryCache.Load(geometrycachefiles::Doodad, digest))
+    {
+        ReadArray(*cached, Vertices);
+        ReadArray(*cached, Indices);
+        return;
+    }
+
+    Parse(reader.get());
+
+    utility::BinaryStream entry(sizeof(std::uint32_t) * 2 +
+                                Vertices.size() * sizeof(math::Vertex) +
+                                Indices.size() * sizeof(int));
+    WriteArray(entry, Vertices);
+    WriteArray(entry, Indices);
+
+    sGeometryCache.Save(geometrycachefiles::Doodad, digest, entry);
+}
+
+void Doodad::Parse(utility::BinaryStream* reader)
+{
     auto const magic = reader->Read<std::uint32_t>();
 
     std::uint32_t vertexCount, indexCount;
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "utility/BinaryStream.hpp"
 #include "utility/Vector.hpp"
 
 #include <string>
@@ -13,6 +14,8 @@ private:
     static constexpr unsigned int Magic = '02DM';
     static constexpr unsigned int AlphaMagic = 'XLDM';
 
+    void Parse(utility::BinaryStream* reader);
+
 public:
     const std::string MpqPath;
 
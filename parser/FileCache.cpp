@@ -0,0 +1,67 @@
+#include "FileCache.hpp"
+
+#include <mutex>
+#include <string>
+
+namespace parser
+{
+FileCache::FileCache(size_t capacity) : m_capacity(capacity), m_size(0) {}
+
+void FileCache::Trim()
+{
+    while (m_size > m_capacity)
+    {
+        auto const& last = m_entries.back();
+
+        m_size -= last.second->size();
+        m_index.erase(last.first);
+        m_entries.pop_back();
+    }
+}
+
+void FileCache::SetCapacity(size_t capacity)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    m_capacity = capacity;
+    Trim();
+}
+
+void FileCache::Clear()
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    m_entries.clear();
+    m_index.clear();
+    m_size = 0;
+}
+
+FileCache::Buffer FileCache::Get(const std::string& name)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    auto const i = m_index.find(name);
+    if (i == m_index.end())
+        return nullptr;
+
+    m_entries.splice(m_entries.begin(), m_entries, i->second);
+
+    return i->second->second;
+}
+
+void FileCache::Insert(const std::string& name, const Buffer& buffer)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    // another thread may have read the same file in the meantime, and a file
+    // which would displace everything else is not worth keeping
+    if (m_index.find(name) != m_index.end() || buffer->size() > m_capacity)
+        return;
+
+    m_entries.emplace_front(name, buffer);
+    m_index[name] = m_entries.begin();
+    m_size += buffer->size();
+
+    Trim();
+}
+} // namespace parser
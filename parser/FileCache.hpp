@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace parser
+{
+// the contents of recently extracted files, shared by every thread.  once the
+// total size exceeds the capacity, the least recently used files are dropped
+class FileCache
+{
+public:
+    using Buffer = std::shared_ptr<const std::vector<std::uint8_t>>;
+
+private:
+    using Entry = std::pair<std::string, Buffer>;
+
+    std::list<Entry> m_entries; // most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> m_index;
+
+    size_t m_capacity;
+    size_t m_size;
+
+    std::mutex m_mutex;
+
+    // assumes the mutex has already been locked
+    void Trim();
+
+public:
+    FileCache(size_t capacity);
+
+    void SetCapacity(size_t capacity);
+    void Clear();
+
+    Buffer Get(const std::string& name);
+    void Insert(const std::string& name, const Buffer& buffer);
+};
+} // namespace parser
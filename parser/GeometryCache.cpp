@@ -0,0 +1,200 @@
+#include "GeometryCache.hpp"
+
+#include "utility/BinaryStream.hpp"
+#include "utility/PicoSHA2/picosha2.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace
+{
+template <typename T>
+void WriteRaw(utility::BinaryStream& stream, const std::vector<T>& values)
+{
+    stream << static_cast<std::uint32_t>(values.size());
+
+    if (!values.empty())
+        stream.Write(&values[0], values.size() * sizeof(T));
+}
+
+template <typename T>
+void ReadRaw(utility::BinaryStream& stream, std::vector<T>& values)
+{
+    auto const count = stream.Read<std::uint32_t>();
+
+    // checked before resizing so that a damaged count cannot exhaust memory
+    if (count * sizeof(T) > stream.wpos() - stream.rpos())
+        throw std::domain_error("Read past end of buffer");
+
+    values.resize(count);
+
+    if (count)
+        stream.ReadBytes(&values[0], count * sizeof(T));
+}
+
+fs::path EntryPath(const fs::path& directory, std::uint32_t kind,
+                   const geometrycachefiles::Digest& digest)
+{
+    std::stringstream str;
+
+    str << std::hex << std::setfill('0');
+    for (auto const byte : digest)
+        str << std::setw(2) << static_cast<int>(byte);
+
+    str << "." << std::setw(8) << kind;
+
+    return directory / str.str();
+}
+} // namespace
+
+namespace parser
+{
+GeometryCache sGeometryCache;
+
+void GeometryCache::Initialize(const fs::path& directory)
+{
+    if (!directory.empty())
+        fs::create_directories(directory);
+
+    m_directory = directory;
+}
+
+geometrycachefiles::Digest
+GeometryCache::Hash(std::uint32_t kind,
+                    const std::vector<utility::BinaryStream*>& files)
+{
+    picosha2::hash256_one_by_one hasher;
+
+    std::vector<std::uint8_t> bytes;
+
+    auto const processValue = [&hasher](std::uint32_t value) {
+        auto const p = reinterpret_cast<const std::uint8_t*>(&value);
+        hasher.process(p, p + sizeof(value));
+    };
+
+    processValue(geometrycachefiles::FileVersion);
+    processValue(kind);
+
+    for (auto const file : files)
+    {
+        if (!file)
+        {
+            processValue(0xFFFFFFFF);
+            continue;
+        }
+
+        auto const old = file->rpos();
+
+        bytes.resize(file->wpos());
+        file->rpos(0);
+        if (!bytes.empty())
+            file->ReadBytes(&bytes[0], bytes.size());
+        file->rpos(old);
+
+        processValue(static_cast<std::uint32_t>(bytes.size()));
+        hasher.process(bytes.begin(), bytes.end());
+    }
+
+    hasher.finish();
+
+    geometrycachefiles::Digest digest;
+    hasher.get_hash_bytes(digest.begin(), digest.end());
+
+    return digest;
+}
+
+std::unique_ptr<utility::BinaryStream>
+GeometryCache::Load(std::uint32_t kind,
+                    const geometrycachefiles::Digest& digest) const
+{
+    auto const path = EntryPath(m_directory, kind, digest);
+
+    std::error_code ec;
+    if (!fs::is_regular_file(path, ec))
+        return nullptr;
+
+    auto result = std::make_unique<utility::BinaryStream>(path);
+
+    constexpr size_t headerSize = 4 * sizeof(std::uint32_t);
+
+    if (result->wpos() < headerSize)
+        return nullptr;
+
+    if (result->Read<std::uint32_t>() != geometrycachefiles::FileSignature ||
+        result->Read<std::uint32_t>() != geometrycachefiles::FileVersion ||
+        result->Read<std::uint32_t>() != kind ||
+        result->Read<std::uint32_t>() != result->wpos() - headerSize)
+        return nullptr;
+
+    return result;
+}
+
+void GeometryCache::Save(std::uint32_t kind,
+                         const geometrycachefiles::Digest& digest,
+                         const utility::BinaryStream& contents) const
+{
+    utility::BinaryStream out(4 * sizeof(std::uint32_t) + contents.wpos());
+
+    out << geometrycachefiles::FileSignature << geometrycachefiles::FileVersion
+        << kind << static_cast<std::uint32_t>(contents.wpos());
+    out << contents;
+
+    auto const path = EntryPath(m_directory, kind, digest);
+
+    // written under a name of its own and then renamed, so that no thread or
+    // later build ever reads a partial entry
+    std::stringstream temp;
+    temp << path.filename().string() << "."
+         << std::hash<std::thread::id>()(std::this_thread::get_id())
+         << ".tmp";
+
+    auto const tempPath = m_directory / temp.str();
+
+    {
+        std::ofstream of(tempPath, std::ofstream::binary | std::ofstream::trunc);
+
+        if (of.fail())
+            return;
+
+        of << out;
+    }
+
+    // a failure only costs the next build the time to parse the file again
+    std::error_code ec;
+    fs::rename(tempPath, path, ec);
+
+    if (ec)
+        fs::remove(tempPath, ec);
+}
+
+void WriteArray(utility::BinaryStream& stream,
+                const std::vector<math::Vertex>& vertices)
+{
+    WriteRaw(stream, vertices);
+}
+
+void WriteArray(utility::BinaryStream& stream, const std::vector<int>& indices)
+{
+    WriteRaw(stream, indices);
+}
+
+void ReadArray(utility::BinaryStream& stream,
+               std::vector<math::Vertex>& vertices)
+{
+    ReadRaw(stream, vertices);
+}
+
+void ReadArray(utility::BinaryStream& stream, std::vector<int>& indices)
+{
+    ReadRaw(stream, indices);
+}
+} // namespace parser
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "utility/BinaryStream.hpp"
+#include "utility/Vector.hpp"
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace geometrycachefiles
+{
+static constexpr std::uint32_t FileSignature = 'GEOC';
+static constexpr std::uint32_t FileVersion = 1;
+
+// what was parsed.  each kind has its own layout, described by its parser
+static constexpr std::uint32_t Adt = 'ADT ';
+static constexpr std::uint32_t Wmo = 'WMO ';
+static constexpr std::uint32_t Doodad = 'M2  ';
+
+using Digest = std::array<std::uint8_t, 32>;
+} // namespace geometrycachefiles
+
+namespace parser
+{
+// the output of the parsers, saved to disk so that later builds may skip
+// parsing those files which have not changed.  entries are named for a digest
+// of the files they were parsed from, so a changed file is simply a new entry.
+// an entry which cannot be read is treated as missing, and replaced
+class GeometryCache
+{
+private:
+    fs::path m_directory;
+
+public:
+    // an empty path disables the cache
+    void Initialize(const fs::path& directory);
+    bool Enabled() const { return !m_directory.empty(); }
+
+    // a digest of the contents of the given files.  missing files are null.
+    // the read positions of the files are left unchanged
+    static geometrycachefiles::Digest
+    Hash(std::uint32_t kind, const std::vector<utility::BinaryStream*>& files);
+
+    // the saved contents, positioned after the header, or null when there is
+    // no usable entry
+    std::unique_ptr<utility::BinaryStream>
+    Load(std::uint32_t kind, const geometrycachefiles::Digest& digest) const;
+    void Save(std::uint32_t kind, const geometrycachefiles::Digest& digest,
+              const utility::BinaryStream& contents) const;
+};
+
+// helpers for the flat arrays from which entries are made
+void WriteArray(utility::BinaryStream& stream,
+                const std::vector<math::Vertex>& vertices);
+void WriteArray(utility::BinaryStream& stream, const std::vector<int>& indices);
+void ReadArray(utility::BinaryStream& stream,
+               std::vector<math::Vertex>& vertices);
+void ReadArray(utility::BinaryStream& stream, std::vector<int>& indices);
+
+extern GeometryCache sGeometryCache;
+} // namespace parser
@@ -13,12 +13,15 @@
 
 #include <cassert>
 #include <cstdint>
+#include <exception>
 #include <fstream>
+#include <future>
 #include <iomanip>
 #include <iostream>
 #include <memory>
 #include <ostream>
 #include <sstream>
+#include <string>
 
 namespace parser
 {
@@ -252,34 +255,61 @@ const Wmo* Map::GetWmo(const std::string& name)
 {
     auto filename = utility::lower(name);
 
-    std::lock_guard<std::mutex> guard(m_wmoMutex);
+    std::promise<std::shared_ptr<const Wmo>> promise;
+    std::shared_future<std::shared_ptr<const Wmo>> future;
+    bool load = false;
 
-    for (auto const& wmo : m_loadedWmos)
-        if (wmo->MpqPath == filename)
-            return wmo.get();
+    {
+        std::lock_guard<std::mutex> guard(m_wmoMutex);
 
-    auto ret = new Wmo(filename);
+        auto const i = m_loadedWmos.find(filename);
 
-    m_loadedWmos.push_back(std::unique_ptr<const Wmo>(ret));
+        if (i != m_loadedWmos.end())
+            future = i->second;
+        else
+        {
+            future = promise.get_future().share();
+            m_loadedWmos.emplace(filename, future);
+            load = true;
+        }
+    }
+
+    // waiting for another thread to load the model
+    if (!load)
+        return future.get().get();
+
+    try
+    {
+        auto wmo = std::make_shared<const Wmo>(filename);
 
-    // loading this WMO also loaded all referenced doodads in all doodad sets
-    // for the wmo. for now, let us share ownership between the WMO and this map
-    std::lock_guard<std::mutex> doodadGuard(m_doodadMutex);
-    for (auto const& doodadSet : ret->DoodadSets)
-        for (auto const& wmoDoodad : doodadSet)
+        // loading this WMO also loaded all referenced doodads in all doodad
+        // sets for the wmo. for now, let us share ownership between the WMO and
+        // this map
         {
-            bool present = false;
-            for (auto const& d : m_loadedDoodads)
-                if (d->MpqPath == wmoDoodad->Parent->MpqPath)
-                {
-                    present = true;
-                    break;
-                }
+            std::lock_guard<std::mutex> guard(m_doodadMutex);
 
-            if (!present)
-                m_loadedDoodads.push_back(wmoDoodad->Parent);
+            for (auto const& doodadSet : wmo->DoodadSets)
+                for (auto const& wmoDoodad : doodadSet)
+                    if (m_loadedDoodads.find(wmoDoodad->Parent->MpqPath) ==
+                        m_loadedDoodads.end())
+                    {
+                        std::promise<std::shared_ptr<const Doodad>> loaded;
+                        loaded.set_value(wmoDoodad->Parent);
+                        m_loadedDoodads.emplace(wmoDoodad->Parent->MpqPath,
+                                                loaded.get_future().share());
+                    }
         }
-    return ret;
+
+        promise.set_value(std::move(wmo));
+    }
+    catch (...)
+    {
+        // those waiting see the same failure
+        promise.set_exception(std::current_exception());
+        throw;
+    }
+
+    return future.get().get();
 }
 
 void Map::InsertWmoInstance(unsigned int uniqueId, const WmoInstance* wmo)
@@ -306,15 +336,40 @@ const Doodad* Map::GetDoodad(const std::string& name)
 {
     auto filename = utility::lower(name);
 
-    std::lock_guard<std::mutex> guard(m_doodadMutex);
+    std::promise<std::shared_ptr<const Doodad>> promise;
+    std::shared_future<std::shared_ptr<const Doodad>> future;
+    bool load = false;
 
-    for (auto const& doodad : m_loadedDoodads)
-        if (doodad->MpqPath == filename)
-            return doodad.get();
+    {
+        std::lock_guard<std::mutex> guard(m_doodadMutex);
 
-    auto ret = new Doodad(name);
-    m_loadedDoodads.push_back(std::unique_ptr<const Doodad>(ret));
-    return ret;
+        auto const i = m_loadedDoodads.find(filename);
+
+        if (i != m_loadedDoodads.end())
+            future = i->second;
+        else
+        {
+            future = promise.get_future().share();
+            m_loadedDoodads.emplace(filename, future);
+            load = true;
+        }
+    }
+
+    // waiting for another thread to load the model
+    if (!load)
+        return future.get().get();
+
+    try
+    {
+        promise.set_value(std::make_shared<const Doodad>(name));
+    }
+    catch (...)
+    {
+        promise.set_exception(std::current_exception());
+        throw;
+    }
+
+    return future.get().get();
 }
 
 void Map::InsertDoodadInstance(unsigned int uniqueId,
@@ -333,7 +388,24 @@ const DoodadInstance* Map::GetDoodadInstance(unsigned int uniqueId) const
     return itr == m_loadedDoodadInstances.end() ? nullptr : itr->second.get();
 }
 
-void Map::Serialize(utility::BinaryStream& stream) const
+namespace
+{
+// instance transforms are affine (rotation, uniform scale and translation), so
+// the bottom row of the inverse is always (0, 0, 0, 1) and only the top three
+// rows are stored
+void WriteInverseTransform(utility::BinaryStream& stream,
+                           const math::Matrix& matrix)
+{
+    auto const inverse = matrix.ComputeInverse();
+
+    for (auto row = 0; row < 3; ++row)
+        stream.Write(inverse[row], 4 * sizeof(float));
+}
+} // namespace
+
+void Map::Serialize(
+    utility::BinaryStream& stream,
+    const std::function<std::uint32_t(const std::string&)>& modelId) const
 {
     const size_t ourSize =
         sizeof(std::uint32_t) + sizeof(std::uint8_t) +
@@ -344,22 +416,22 @@ void Map::Serialize(utility::BinaryStream& stream) const
               (sizeof(std::uint32_t) + // id
                sizeof(std::uint16_t) + // doodad set
                sizeof(std::uint16_t) + // name set
-               22 * sizeof(float) + // 16 floats for transform matrix, 6 floats
-                                    // for bounds
-               MeshSettings::MaxMPQPathLength    // model file name
+               34 * sizeof(float) + // 16 floats for transform matrix, 12 for
+                                    // its affine inverse, 6 for bounds
+               sizeof(std::uint32_t)             // model id
                ) * m_loadedWmoInstances.size() + // for each wmo instance
               sizeof(std::uint32_t) +            // loaded doodad size
               (sizeof(std::uint32_t) +           // id
-               22 * sizeof(float) + // 16 floats for transform matrix, 6 floats
-                                    // for bounds
-               MeshSettings::MaxMPQPathLength // model file name
+               34 * sizeof(float) + // 16 floats for transform matrix, 12 for
+                                    // its affine inverse, 6 for bounds
+               sizeof(std::uint32_t) // model id
                ) * m_loadedDoodadInstances.size()) :
              (sizeof(std::uint32_t) + // id
               sizeof(std::uint16_t) + // doodad set
               sizeof(std::uint16_t) + // name set
-              22 * sizeof(float) + // 16 floats for transform matrix, 6 floats
-                                   // for bounds
-              MeshSettings::MaxMPQPathLength // model file name
+              34 * sizeof(float) + // 16 floats for transform matrix, 12 for
+                                   // its affine inverse, 6 for bounds
+              sizeof(std::uint32_t) // model id
               ));
 
     utility::BinaryStream ourStream(ourSize);
@@ -401,9 +473,9 @@ void Map::Serialize(utility::BinaryStream& stream) const
                 ourStream << static_cast<std::uint16_t>(wmo.second->DoodadSet);
                 ourStream << static_cast<std::uint16_t>(wmo.second->NameSet);
                 ourStream << wmo.second->TransformMatrix;
+                WriteInverseTransform(ourStream, wmo.second->TransformMatrix);
                 ourStream << wmo.second->Bounds;
-                ourStream.WriteString(wmo.second->Model->MpqPath,
-                                      MeshSettings::MaxMPQPathLength);
+                ourStream << modelId(wmo.second->Model->MpqPath);
             }
         }
 
@@ -417,9 +489,10 @@ void Map::Serialize(utility::BinaryStream& stream) const
             {
                 ourStream << static_cast<std::uint32_t>(doodad.first);
                 ourStream << doodad.second->TransformMatrix;
+                WriteInverseTransform(ourStream,
+                                      doodad.second->TransformMatrix);
                 ourStream << doodad.second->Bounds;
-                ourStream.WriteString(doodad.second->Model->MpqPath,
-                                      MeshSettings::MaxMPQPathLength);
+                ourStream << modelId(doodad.second->Model->MpqPath);
             }
         }
     }
@@ -435,9 +508,9 @@ void Map::Serialize(utility::BinaryStream& stream) const
         ourStream << static_cast<std::uint16_t>(wmo->DoodadSet);
         ourStream << static_cast<std::uint16_t>(wmo->NameSet);
         ourStream << wmo->TransformMatrix;
+        WriteInverseTransform(ourStream, wmo->TransformMatrix);
         ourStream << wmo->Bounds;
-        ourStream.WriteString(wmo->Model->MpqPath,
-                              MeshSettings::MaxMPQPathLength);
+        ourStream << modelId(wmo->Model->MpqPath);
     }
 
     // make sure our prediction of the final size is correct, to avoid
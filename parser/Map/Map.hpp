@@ -6,12 +6,15 @@
 #include "utility/BinaryStream.hpp"
 
 #include <cstdint>
+#include <functional>
+#include <future>
 #include <map>
 #include <memory>
 #include <mutex>
 #include <ostream>
 #include <set>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace parser
@@ -40,16 +43,23 @@ private:
     std::unique_ptr<Adt> m_adts[MeshSettings::Adts][MeshSettings::Adts];
     std::unique_ptr<WmoInstance> m_globalWmo;
 
+    // models are loaded by the first thread to ask for them, without holding
+    // the mutex.  others asking for the same model wait on its future
+
     mutable std::mutex m_wmoMutex;
-    std::vector<std::unique_ptr<const Wmo>> m_loadedWmos;
+    std::unordered_map<std::string,
+                       std::shared_future<std::shared_ptr<const Wmo>>>
+        m_loadedWmos;
     std::map<std::uint32_t, std::unique_ptr<const WmoInstance>>
         m_loadedWmoInstances;
     std::map<std::uint64_t, std::unique_ptr<const WmoInstance>>
         m_loadedWmoGameObjects;
 
     mutable std::mutex m_doodadMutex;
-    std::vector<std::shared_ptr<const Doodad>>
-        m_loadedDoodads; // must be shared because it can also be owned by a WMO
+    // must be shared because it can also be owned by a WMO
+    std::unordered_map<std::string,
+                       std::shared_future<std::shared_ptr<const Doodad>>>
+        m_loadedDoodads;
     std::map<std::uint32_t, std::unique_ptr<const DoodadInstance>>
         m_loadedDoodadInstances;
     std::map<std::uint64_t, std::unique_ptr<const WmoInstance>>
@@ -79,6 +89,9 @@ public:
                               const DoodadInstance* doodad);
     const DoodadInstance* GetDoodadInstance(unsigned int uniqueId) const;
 
-    void Serialize(utility::BinaryStream& stream) const;
+    // models are referred to by the id returned for their mpq path
+    void Serialize(
+        utility::BinaryStream& stream,
+        const std::function<std::uint32_t(const std::string&)>& modelId) const;
 };
 } // namespace parser
\ No newline at end of file
@@ -6,13 +6,17 @@
 #include "utility/String.hpp"
 
 #include <algorithm>
+#include <atomic>
 #include <cctype>
 #include <cstdint>
 #include <filesystem>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <sstream>
 #include <system_error>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace
@@ -84,25 +88,171 @@ std::string GetRealModelPath(const std::string& path, bool alpha)
         return path.substr(0, length - 4) + ".m2";
     }
 }
+
+// file and archive names are compared in lower case with backslashes
+std::string NormalizeName(const std::string& name)
+{
+    auto result = utility::lower(name);
+    std::replace(result.begin(), result.end(), '/', '\\');
+    return result;
+}
+
+// StormLib names the files it finds no name for "File00000000.xxx"
+bool IsUnnamedFile(const std::string& name)
+{
+    if (name.length() < 13 || name.compare(0, 4, "File") != 0 ||
+        name[12] != '.')
+        return false;
+
+    return std::all_of(name.begin() + 4, name.begin() + 12,
+                       [](char c) { return c >= '0' && c <= '9'; });
+}
+
+std::atomic<std::uint64_t> sGeneration(0);
+
+// the archives opened by one thread, for the archive list of one generation
+struct ThreadArchives
+{
+    std::uint64_t Generation = 0;
+    std::vector<void*> Handles;
+
+    void Close()
+    {
+        for (auto const handle : Handles)
+            if (handle)
+                SFileCloseArchive(handle);
+
+        Handles.clear();
+    }
+
+    ~ThreadArchives() { Close(); }
+};
+
+thread_local ThreadArchives sThreadArchives;
 } // namespace
 
 namespace parser
 {
-thread_local MpqManager sMpqManager;
+MpqManager sMpqManager;
+
+MpqManager::MpqManager() : Cache(256 * 1024 * 1024) {}
 
-void MpqManager::LoadMpq(const fs::path& filePath)
+std::shared_ptr<const MpqManager::Data> MpqManager::GetData() const
 {
-    HANDLE archive;
+    std::lock_guard<std::mutex> guard(DataMutex);
 
-    if (!SFileOpenArchive(filePath.string().c_str(), 0, MPQ_OPEN_READ_ONLY, &archive))
+    if (!CurrentData)
+        THROW(Result::MPQ_MANAGER_NOT_INIATIALIZED);
+
+    return CurrentData;
+}
+
+MpqManager::HANDLE MpqManager::GetArchive(const Data& data, size_t archive)
+{
+    if (sThreadArchives.Generation != data.Generation)
+    {
+        sThreadArchives.Close();
+        sThreadArchives.Generation = data.Generation;
+        sThreadArchives.Handles.resize(data.Archives.size(), nullptr);
+    }
+
+    auto& handle = sThreadArchives.Handles[archive];
+
+    if (!handle &&
+        !SFileOpenArchive(data.Archives[archive].string().c_str(), 0,
+                          MPQ_OPEN_READ_ONLY, &handle))
         THROW(Result::COULD_NOT_OPEN_MPQ).ErrorCode();
 
-    std::error_code ec;
-    auto const rel = fs::relative(filePath, BasePath, ec);
-    if (ec)
-        MpqHandles[filePath.string()] = archive;
-    else
-        MpqHandles[utility::lower(rel.string())] = archive;
+    return handle;
+}
+
+FileCache::Buffer MpqManager::ReadFile(HANDLE archive,
+                                       const std::string& file)
+{
+    HANDLE fileHandle;
+    if (!SFileOpenFileEx(archive, file.c_str(), SFILE_OPEN_FROM_MPQ,
+                         &fileHandle))
+        THROW(Result::ERROR_IN_SFILEOPENFILEX).ErrorCode();
+
+    auto const fileSize = SFileGetFileSize(fileHandle, nullptr);
+
+    if (!fileSize)
+    {
+        SFileCloseFile(fileHandle);
+        return nullptr;
+    }
+
+    auto inFileData = std::make_shared<std::vector<std::uint8_t>>(fileSize);
+
+    if (!SFileReadFile(fileHandle, inFileData->data(),
+                       static_cast<DWORD>(inFileData->size()), nullptr,
+                       nullptr))
+    {
+        SFileCloseFile(fileHandle);
+        THROW(Result::ERROR_IN_SFILEREADFILE).ErrorCode();
+    }
+
+    SFileCloseFile(fileHandle);
+
+    return inFileData;
+}
+
+FileCache::Buffer MpqManager::ReadFile(const Data& data,
+                                       const std::string& file)
+{
+    auto const index = FindArchive(data, file);
+
+    if (index >= 0)
+        if (auto result = ReadFile(GetArchive(data, index), file))
+            return result;
+
+    // it is possible that we reach here when operating on alpha data, when
+    // many (all?) files were in their own MPQ.  lets check for that next...
+    auto const alphaArchive = data.ArchiveNames.find(file + ".mpq");
+
+    if (alphaArchive == data.ArchiveNames.end())
+        return nullptr;
+
+    // if we have found a match, there should be exactly two files in this
+    // mpq: the data file, and a checksum file.
+
+    auto const archive = GetArchive(data, alphaArchive->second);
+
+    SFILE_FIND_DATA findData;
+    auto const search = SFileFindFirstFile(archive, "*", &findData, nullptr);
+    if (!search)
+        return nullptr;
+
+    // TODO: what follows is probably over kill, but left here to test the
+    // assumptions the code relies on.
+    std::vector<std::string> files;
+    std::string candidate("");
+    do
+    {
+        const std::string fn(findData.cFileName);
+        files.push_back(fn);
+
+        if (fn != "(attributes)" && findData.dwFileSize != 16 &&
+            findData.dwFileSize != 0)
+        {
+            if (!candidate.empty())
+                THROW(Result::MULTIPLE_CANDIDATES_IN_ALPHA_MPQ);
+            candidate = fn;
+        }
+
+        if (!SFileFindNextFile(search, &findData))
+        {
+            SFileFindClose(search);
+            break;
+        }
+    } while (true);
+
+    if (files.size() != 3)
+        THROW(Result::TOO_MANY_FILES_IN_ALPHA_MPQ);
+    if (candidate.empty())
+        THROW(Result::NO_MPQ_CANDIDATE);
+
+    return ReadFile(archive, candidate);
 }
 
 void MpqManager::Initialize()
@@ -113,14 +263,32 @@ void MpqManager::Initialize()
 // Priority logic is explained at https://github.com/namreeb/namigator/issues/22
 void MpqManager::Initialize(const fs::path& wowDir)
 {
+    std::lock_guard<std::mutex> initializeGuard(InitializeMutex);
+
+    {
+        std::lock_guard<std::mutex> guard(DataMutex);
+
+        if (CurrentData && CurrentData->BasePath == wowDir)
+            return;
+    }
+
     if (!fs::is_directory(wowDir))
         THROW(Result::NO_DATA_FILES_FOUND);
 
-    Alpha = false;
-    BasePath = fs::path(wowDir);
+    // nothing cached from the previous directory may be returned for this one
+    Cache.Clear();
+
+    auto data = std::make_shared<Data>();
+
+    data->Generation = ++sGeneration;
+    data->Alpha = false;
+    data->BasePath = fs::path(wowDir);
+
+    auto const& basePath = data->BasePath;
+
     std::string locale = "";
 
-    for (auto const& d : fs::directory_iterator(BasePath))
+    for (auto const& d : fs::directory_iterator(basePath))
     {
         if (!fs::is_directory(d.status()))
             continue;
@@ -132,85 +300,149 @@ void MpqManager::Initialize(const fs::path& wowDir)
 
         // all locale directories should have files named lcLE\locale-lcLE.mpq
         // and lcLE\patch-lcLE*.mpq
-        if (fs::exists(BasePath / dirString / ("locale-" + dirString + ".MPQ")))
+        if (fs::exists(basePath / dirString / ("locale-" + dirString + ".MPQ")))
         {
             locale = dirString;
             break;
         }
     }
 
+    // the archives are listed in order of priority, highest first, since a
+    // file found in an earlier archive hides the same file in any later one.
+    // each patch overrides the archives released before it, so the locale
+    // patches come first, then the numbered patches from the newest down, then
+    // patch.MPQ, and the archives shipped with the client last.  locale
+    // archives precede the others because they replace some of their files
     std::vector<fs::path> files;
 
-    // if we are running on test data we do not expect to find a locale
-    AddIfExists(files, BasePath / "test_map.mpq");
-
-    AddIfExists(files, BasePath / "base.MPQ");
-    AddIfExists(files, BasePath / "dbc.MPQ");
-    AddIfExists(files, BasePath / "model.MPQ");
-    AddIfExists(files, BasePath / "alternate.MPQ");
-    AddIfExists(files, BasePath / ".." / "alternate.MPQ");
-    AddIfExists(files, BasePath / "speech2.MPQ");
-    AddIfExists(files, BasePath / ".." / "speech2.MPQ");
-
     for (auto i = 9; i > 0; --i)
     {
         std::stringstream s1;
-        s1 << "patch-" << i << ".MPQ";
-        AddIfExists(files, BasePath / s1.str());
+        s1 << "patch-" << locale << "-" << i << ".MPQ";
+        AddIfExists(files, basePath / locale / s1.str());
     }
 
+    AddIfExists(files, basePath / locale / ("patch-" + locale + ".MPQ"));
+
     for (auto i = 9; i > 0; --i)
     {
         std::stringstream s1;
-        s1 << "patch-" << locale << "-" << i << ".MPQ";
-        AddIfExists(files, BasePath / locale / s1.str());
+        s1 << "patch-" << i << ".MPQ";
+        AddIfExists(files, basePath / s1.str());
     }
 
+    AddIfExists(files, basePath / "patch.MPQ");
+
+    AddIfExists(files, basePath / locale /
+                            ("lichking-speech-" + locale + ".MPQ"));
+    AddIfExists(files, basePath / locale /
+                            ("expansion-speech-" + locale + ".MPQ"));
+    AddIfExists(files, basePath / locale /
+                            ("lichking-locale-" + locale + ".MPQ"));
+    AddIfExists(files, basePath / locale /
+                            ("expansion-locale-" + locale + ".MPQ"));
+    AddIfExists(files, basePath / locale / ("speech-" + locale + ".MPQ"));
+    AddIfExists(files, basePath / locale / ("locale-" + locale + ".MPQ"));
+
+    // if we are running on test data we do not expect to find a locale
+    AddIfExists(files, basePath / "test_map.mpq");
+
+    AddIfExists(files, basePath / "lichking.MPQ");
+    AddIfExists(files, basePath / "expansion.MPQ");
+    AddIfExists(files, basePath / "terrain.MPQ");
+    AddIfExists(files, basePath / "common-2.MPQ");
+    AddIfExists(files, basePath / "common.MPQ");
+    AddIfExists(files, basePath / "wmo.MPQ");
+    AddIfExists(files, basePath / "base.MPQ");
+    AddIfExists(files, basePath / "dbc.MPQ");
+    AddIfExists(files, basePath / "model.MPQ");
+    AddIfExists(files, basePath / "alternate.MPQ");
+    AddIfExists(files, basePath / ".." / "alternate.MPQ");
+    AddIfExists(files, basePath / "speech2.MPQ");
+    AddIfExists(files, basePath / ".." / "speech2.MPQ");
+
     // the alpha client stores data in lots of small MPQs inside the
     // Data/World directory
-    if (fs::is_directory(BasePath / "World"))
+    if (fs::is_directory(basePath / "World"))
     {
-        Alpha = true;
+        data->Alpha = true;
 
         for (auto const& f :
-                fs::recursive_directory_iterator(BasePath / "World"))
+                fs::recursive_directory_iterator(basePath / "World"))
             AddIfMpq(files, f);
     }
 
-    AddIfExists(files, BasePath / "patch.MPQ");
-    AddIfExists(files, BasePath / locale / ("patch-" + locale + ".MPQ"));
-    AddIfExists(files, BasePath / "wmo.MPQ");
-    AddIfExists(files, BasePath / "expansion.MPQ");
-    AddIfExists(files, BasePath / "lichking.MPQ");
-    AddIfExists(files, BasePath / "common.MPQ");
-    AddIfExists(files, BasePath / "common-2.MPQ");
-    AddIfExists(files, BasePath / "terrain.MPQ");
-    AddIfExists(files, BasePath / locale / ("locale-" + locale + ".MPQ"));
-    AddIfExists(files, BasePath / locale / ("speech-" + locale + ".MPQ"));
-    AddIfExists(files, BasePath / locale /
-                            ("expansion-locale-" + locale + ".MPQ"));
-    AddIfExists(files,
-                BasePath / locale / ("lichking-locale-" + locale + ".MPQ"));
-    AddIfExists(files, BasePath / locale /
-                            ("expansion-speech-" + locale + ".MPQ"));
-    AddIfExists(files,
-                BasePath / locale / ("lichking-speech-" + locale + ".MPQ"));
-
     if (files.empty())
         THROW(Result::NO_DATA_FILES_FOUND);
 
     for (auto const& file : files)
-        LoadMpq(file);
+    {
+        auto const index = data->Archives.size();
+
+        std::error_code ec;
+        auto const rel = fs::relative(file, basePath, ec);
+
+        data->ArchiveNames[NormalizeName(ec ? file.string() : rel.string())] =
+            index;
+        data->Archives.push_back(file);
 
-    const DBC maps("DBFilesClient\\Map.dbc");
+        // archives are otherwise only opened by the threads which read from
+        // them
+        HANDLE archive;
+        if (!SFileOpenArchive(file.string().c_str(), 0, MPQ_OPEN_READ_ONLY,
+                              &archive))
+            THROW(Result::COULD_NOT_OPEN_MPQ).ErrorCode();
+
+        SFILE_FIND_DATA findData;
+        auto const search =
+            SFileFindFirstFile(archive, "*", &findData, nullptr);
+
+        bool unlisted = false;
+
+        if (search)
+        {
+            do
+            {
+                const std::string name(findData.cFileName);
+
+                if (IsUnnamedFile(name))
+                    unlisted = true;
+                // empty files are passed over in favor of the next archive.
+                // an archive earlier in the list keeps the file
+                else if (findData.dwFileSize != 0)
+                    data->Files.emplace(NormalizeName(name), index);
+            } while (SFileFindNextFile(search, &findData));
+
+            SFileFindClose(search);
+        }
+
+        if (unlisted)
+            data->UnlistedArchives.push_back(index);
+
+        SFileCloseArchive(archive);
+    }
+
+    // the tables are read from the new archives before they are published, so
+    // that a failure leaves the previous data in place
+    auto const readDbc = [this, &data](const std::string& name) {
+        auto buffer = ReadFile(*data, NormalizeName(name));
+
+        if (!buffer)
+            THROW_MSG("Failed to open DBC " + name, Result::FAILED_TO_OPEN_DBC);
+
+        utility::BinaryStream stream(std::move(buffer));
+        return DBC(stream);
+    };
+
+    auto const maps = readDbc("DBFilesClient\\Map.dbc");
 
     for (auto i = 0u; i < maps.RecordCount(); ++i)
     {
         auto const map_name = utility::lower(maps.GetStringField(i, 1));
-        Maps[map_name] = maps.GetField(i, 0);
+        data->Maps[map_name] = maps.GetField(i, 0);
     }
 
-    const DBC area("DBFilesClient\\AreaTable.dbc");
+    auto const area = readDbc("DBFilesClient\\AreaTable.dbc");
     std::unordered_map<std::uint32_t, std::uint32_t> areaToZone;
     for (auto i = 0; i < area.RecordCount(); ++i)
     {
@@ -221,138 +453,76 @@ void MpqManager::Initialize(const fs::path& wowDir)
     }
 
     for (auto const& i : areaToZone)
-        AreaToZone[i.first] = GetRootAreaId(areaToZone, i.first);
-}
+        data->AreaToZone[i.first] = GetRootAreaId(areaToZone, i.first);
 
-bool MpqManager::FileExists(const std::string& file) const
-{
-    for (auto const& i : MpqHandles)
-        if (SFileHasFile(i.second, file.c_str()))
-            return true;
-    return false;
+    std::lock_guard<std::mutex> guard(DataMutex);
+    CurrentData = data;
 }
 
-std::unique_ptr<utility::BinaryStream>
-MpqManager::OpenFile(const std::string& file)
+int MpqManager::FindArchive(const Data& data, const std::string& file)
 {
-    if (MpqHandles.empty())
-        THROW(Result::MPQ_MANAGER_NOT_INIATIALIZED);
-
-    auto file_lower = utility::lower(GetRealModelPath(file, Alpha));
+    auto const i = data.Files.find(file);
+    auto const listed =
+        i == data.Files.end() ? data.Archives.size() : i->second;
 
-    for (auto const& i : MpqHandles)
+    // files which the listfiles do not name can only be searched for.  an
+    // unlisted archive of higher priority than the listed one overrides it
+    for (auto const archive : data.UnlistedArchives)
     {
-        if (!SFileHasFile(i.second, file_lower.c_str()))
-            continue;
-
-        HANDLE fileHandle;
-        if (!SFileOpenFileEx(i.second, file_lower.c_str(), SFILE_OPEN_FROM_MPQ,
-                             &fileHandle))
-            THROW(Result::ERROR_IN_SFILEOPENFILEX).ErrorCode();
-
-        auto const fileSize = SFileGetFileSize(fileHandle, nullptr);
-
-        if (!fileSize)
-            continue;
-
-        std::vector<std::uint8_t> inFileData(fileSize);
-
-        if (!SFileReadFile(fileHandle, &inFileData[0],
-                           static_cast<DWORD>(inFileData.size()), nullptr,
-                           nullptr))
-        {
-            SFileCloseFile(fileHandle);
-            THROW(Result::ERROR_IN_SFILEREADFILE).ErrorCode();
-        }
-
-        SFileCloseFile(fileHandle);
+        if (archive >= listed)
+            break;
 
-        return std::make_unique<utility::BinaryStream>(inFileData);
+        if (SFileHasFile(GetArchive(data, archive), file.c_str()))
+            return static_cast<int>(archive);
     }
 
-    // it is possible that we reach here when operating on alpha data, when
-    // many (all?) files were in their own MPQ.  lets check for that next...
-    file_lower += ".mpq";
-
-    for (auto const& i : MpqHandles)
-    {
-        // if we are on Linux, the mpq filenames will use forward slashes
-        // instead of backslashes.  this code could be cleaner.
-        std::string mpqPath = i.first;
-        std::replace(mpqPath.begin(), mpqPath.end(), '/', '\\');
-
-        if (mpqPath != file_lower)
-            continue;
-
-        // if we have found a match, there should be exactly two files in this
-        // mpq: the data file, and a checksum file.
-
-        SFILE_FIND_DATA data;
-        auto const search = SFileFindFirstFile(i.second, "*", &data, nullptr);
-        if (!search)
-            continue;
-
-        // TODO: what follows is probably over kill, but left here to test the
-        // assumptions the code relies on.
-        std::vector<std::string> files;
-        std::string candidate("");
-        do
-        {
-            const std::string fn(data.cFileName);
-            files.push_back(fn);
+    return listed < data.Archives.size() ? static_cast<int>(listed) : -1;
+}
 
-            if (fn != "(attributes)" && data.dwFileSize != 16 &&
-                data.dwFileSize != 0)
-            {
-                if (!candidate.empty())
-                    THROW(Result::MULTIPLE_CANDIDATES_IN_ALPHA_MPQ);
-                candidate = fn;
-            }
+bool MpqManager::FileExists(const std::string& file) const
+{
+    auto const data = GetData();
 
-            if (!SFileFindNextFile(search, &data))
-            {
-                SFileFindClose(search);
-                break;
-            }
-        } while (true);
+    return FindArchive(*data, NormalizeName(file)) >= 0;
+}
 
-        if (files.size() != 3)
-            THROW(Result::TOO_MANY_FILES_IN_ALPHA_MPQ);
-        if (candidate.empty())
-            THROW(Result::NO_MPQ_CANDIDATE);
+void MpqManager::SetCacheCapacity(size_t capacity)
+{
+    Cache.SetCapacity(capacity);
+}
 
-        HANDLE fileHandle;
-        if (!SFileOpenFileEx(i.second, candidate.c_str(), SFILE_OPEN_FROM_MPQ,
-                             &fileHandle))
-            THROW(Result::ERROR_IN_SFILEOPENFILEX).ErrorCode();
+std::unique_ptr<utility::BinaryStream>
+MpqManager::OpenFile(const std::string& file)
+{
+    auto const data = GetData();
 
-        auto const fileSize = SFileGetFileSize(fileHandle, nullptr);
+    auto const name = NormalizeName(GetRealModelPath(file, data->Alpha));
 
-        std::vector<std::uint8_t> inFileData(fileSize);
+    auto buffer = Cache.Get(name);
 
-        if (!SFileReadFile(fileHandle, &inFileData[0],
-                           static_cast<DWORD>(inFileData.size()), nullptr,
-                           nullptr))
-        {
-            SFileCloseFile(fileHandle);
-            THROW(Result::ERROR_IN_SFILEREADFILE).ErrorCode();
-        }
+    if (!buffer)
+    {
+        buffer = ReadFile(*data, name);
 
-        SFileCloseFile(fileHandle);
+        if (!buffer)
+            return nullptr;
 
-        return std::make_unique<utility::BinaryStream>(inFileData);
+        Cache.Insert(name, buffer);
     }
 
-    return nullptr;
+    // the stream shares the cached contents until it is written to
+    return std::make_unique<utility::BinaryStream>(std::move(buffer));
 }
 
 unsigned int MpqManager::GetMapId(const std::string& name) const
 {
+    auto const data = GetData();
+
     std::string nameLower = utility::lower(name);
 
-    auto const i = Maps.find(nameLower);
+    auto const i = data->Maps.find(nameLower);
 
-    if (i == Maps.end())
+    if (i == data->Maps.end())
         THROW_MSG("Map ID for " + name + " not found", Result::MAP_ID_NOT_FOUND);
 
     return i->second;
@@ -360,9 +530,11 @@ unsigned int MpqManager::GetMapId(const std::string& name) const
 
 unsigned int MpqManager::GetZoneId(unsigned int areaId) const
 {
-    auto const i = AreaToZone.find(areaId);
+    auto const data = GetData();
+
+    auto const i = data->AreaToZone.find(areaId);
 
-    if (i == AreaToZone.end())
+    if (i == data->AreaToZone.end())
         return 0;
 
     return i->second;
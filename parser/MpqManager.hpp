@@ -1,9 +1,12 @@
 #pragma once
 
+#include "FileCache.hpp"
 #include "utility/BinaryStream.hpp"
 
+#include <cstdint>
 #include <filesystem>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -12,25 +15,74 @@ namespace fs = std::filesystem;
 
 namespace parser
 {
+// one manager is shared by every thread.  the archive list and the tables read
+// from the DBCs never change once initialized.  StormLib handles may not be
+// shared between threads, so each thread opens the archives it reads from
+// itself
 class MpqManager
 {
 private:
     using HANDLE = void*;
 
-    bool Alpha;
+    struct Data
+    {
+        // identifies the archive list for which a thread's handles were opened
+        std::uint64_t Generation;
 
-    fs::path BasePath;
+        bool Alpha;
 
-    std::unordered_map<std::string, HANDLE> MpqHandles;
-    std::unordered_map<std::string, unsigned int> Maps;
-    std::unordered_map<std::uint32_t, std::uint32_t> AreaToZone;
+        fs::path BasePath;
 
-    void LoadMpq(const std::filesystem::path& filePath);
+        // in order of priority, highest first
+        std::vector<fs::path> Archives;
+
+        // archives by their path relative to the data directory, for alpha
+        // data where each file is in an archive of its own
+        std::unordered_map<std::string, size_t> ArchiveNames;
+
+        // the highest priority archive holding each file named in the
+        // archives' listfiles, and those archives holding files which are not
+        std::unordered_map<std::string, size_t> Files;
+        std::vector<size_t> UnlistedArchives;
+
+        std::unordered_map<std::string, unsigned int> Maps;
+        std::unordered_map<std::uint32_t, std::uint32_t> AreaToZone;
+    };
+
+    std::shared_ptr<const Data> CurrentData;
+
+    mutable std::mutex DataMutex;
+    std::mutex InitializeMutex;
+
+    // files already extracted, by normalized name
+    FileCache Cache;
+
+    std::shared_ptr<const Data> GetData() const;
+
+    // the calling thread's handle for the archive, opened on first use
+    static HANDLE GetArchive(const Data& data, size_t archive);
+
+    // the file's contents, or null when it is empty
+    static FileCache::Buffer ReadFile(HANDLE archive, const std::string& file);
+
+    FileCache::Buffer ReadFile(const Data& data, const std::string& file);
+
+    // the archive holding the file, or -1
+    static int FindArchive(const Data& data, const std::string& file);
 
 public:
+    MpqManager();
+
+    // initializing again with the same directory does nothing, so that every
+    // thread may safely do so before it begins.  initializing with another
+    // directory must not happen while other threads are reading files
     void Initialize();
     void Initialize(const fs::path& wowDir);
 
+    // the most memory, in bytes, which the contents of extracted files may
+    // occupy once no longer in use.  zero disables caching
+    void SetCacheCapacity(size_t capacity);
+
     bool FileExists(const std::string& file) const;
     std::unique_ptr<utility::BinaryStream> OpenFile(const std::string& file);
 
@@ -38,5 +90,5 @@ public:
     unsigned int GetZoneId(unsigned int areaId) const;
 };
 
-extern thread_local MpqManager sMpqManager;
-}; // namespace parser
\ No newline at end of file
+extern MpqManager sMpqManager;
+}; // namespace parser
@@ -2,6 +2,7 @@
 
 #include "Common.hpp"
 #include "DBC.hpp"
+#include "GeometryCache.hpp"
 #include "MpqManager.hpp"
 #include "Wmo/GroupFile/WmoGroupFile.hpp"
 #include "Wmo/RootFile/Chunks/MODD.hpp"
@@ -18,6 +19,8 @@
 #include <map>
 #include <memory>
 #include <sstream>
+#include <string>
+#include <utility>
 #include <vector>
 
 namespace parser
@@ -56,30 +59,25 @@ Wmo::Wmo(const std::string& path) : MpqPath(utility::lower(path))
     input::MOHD information;
     reader->ReadBytes(&information, sizeof(information));
 
-    std::vector<std::unique_ptr<input::WmoGroupFile>> groupFiles;
-    groupFiles.reserve(information.WMOGroupFilesCount);
+    // the group files are read up front, as they are part of the cache key.
+    // alpha data has its groups in the root file
+    std::vector<std::unique_ptr<utility::BinaryStream>> groupReaders;
 
-    // alpha data
-    if (version == 14)
-    {
-        for (int i = 0; i < information.WMOGroupFilesCount; ++i)
-            groupFiles.push_back(
-                std::make_unique<input::WmoGroupFile>(version, reader.get()));
-    }
-    else
+    if (version != 14)
     {
         auto fileName = path.substr(path.rfind('\\') + 1);
         fileName = fileName.substr(0, fileName.rfind('.'));
         auto const dirName = path.substr(0, path.rfind('\\'));
 
+        groupReaders.reserve(information.WMOGroupFilesCount);
+
         for (int i = 0; i < information.WMOGroupFilesCount; ++i)
         {
             std::stringstream ss;
 
             ss << dirName << "\\" << fileName << "_" << std::setfill('0')
                << std::setw(3) << i << ".wmo";
-            groupFiles.push_back(
-                std::make_unique<input::WmoGroupFile>(version, ss.str()));
+            groupReaders.push_back(sMpqManager.OpenFile(ss.str()));
         }
     }
 
@@ -140,8 +138,150 @@ Wmo::Wmo(const std::string& path) : MpqPath(utility::lower(path))
 
     RootId = information.WMOId;
 
+    // the doodads placed by each doodad set
+    std::vector<std::vector<std::pair<std::string, math::Matrix>>> placements;
+
+    geometrycachefiles::Digest digest;
+    std::unique_ptr<utility::BinaryStream> cached;
+
+    if (sGeometryCache.Enabled())
+    {
+        std::vector<utility::BinaryStream*> sources {reader.get()};
+        for (auto const& groupReader : groupReaders)
+            sources.push_back(groupReader.get());
+
+        digest = GeometryCache::Hash(geometrycachefiles::Wmo, sources);
+        cached = sGeometryCache.Load(geometrycachefiles::Wmo, digest);
+    }
+
+    if (cached)
+    {
+        ReadArray(*cached, Vertices);
+        ReadArray(*cached, Indices);
+        ReadArray(*cached, LiquidVertices);
+        ReadArray(*cached, LiquidIndices);
+
+        placements.resize(cached->Read<std::uint32_t>());
+
+        for (auto& set : placements)
+        {
+            set.resize(cached->Read<std::uint32_t>());
+
+            for (auto& placement : set)
+            {
+                placement.first =
+                    cached->ReadString(cached->Read<std::uint32_t>());
+
+                float transform[16];
+                cached->ReadBytes(transform, sizeof(transform));
+                placement.second = math::Matrix::CreateFromArray(transform, 16);
+            }
+        }
+    }
+    else
+    {
+        ParseGroupFiles(version, information.WMOGroupFilesCount, reader.get(),
+                        groupReaders);
+
+        input::MODS doodadSetsChunk(information.DoodadSetsCount, modsLocation,
+                                    reader.get());
+        input::MODN doodadNamesChunk(information.DoodadNamesCount,
+                                     modnLocation, reader.get());
+        input::MODD doodadChunk(moddLocation, reader.get());
+
+        placements.resize(doodadSetsChunk.DoodadSets.size());
+
+        for (size_t i = 0; i < doodadSetsChunk.DoodadSets.size(); ++i)
+        {
+            auto const& set = doodadSetsChunk.DoodadSets[i];
+
+            placements[i].reserve(set.DoodadCount);
+
+            for (auto d = set.FirstDoodadIndex;
+                 d < set.FirstDoodadIndex + set.DoodadCount; ++d)
+            {
+                auto const& placement = doodadChunk.Doodads[d];
+                auto const& name = doodadNamesChunk.Names[placement.NameIndex];
+
+                // TODO: figure out why this happens
+                if (name.empty())
+                    continue;
+
+                math::Matrix transformMatrix;
+                placement.GetTransformMatrix(transformMatrix);
+
+                placements[i].emplace_back(name, transformMatrix);
+            }
+        }
+
+        if (sGeometryCache.Enabled())
+        {
+            utility::BinaryStream entry(
+                sizeof(std::uint32_t) * 4 +
+                (Vertices.size() + LiquidVertices.size()) *
+                    sizeof(math::Vertex) +
+                (Indices.size() + LiquidIndices.size()) * sizeof(int));
+
+            WriteArray(entry, Vertices);
+            WriteArray(entry, Indices);
+            WriteArray(entry, LiquidVertices);
+            WriteArray(entry, LiquidIndices);
+
+            entry << static_cast<std::uint32_t>(placements.size());
+
+            for (auto const& set : placements)
+            {
+                entry << static_cast<std::uint32_t>(set.size());
+
+                for (auto const& placement : set)
+                {
+                    entry << static_cast<std::uint32_t>(
+                        placement.first.length());
+                    entry.Write(placement.first.data(),
+                                placement.first.length());
+
+                    float transform[16];
+                    placement.second.PopulateArray(transform);
+                    entry.Write(transform, sizeof(transform));
+                }
+            }
+
+            sGeometryCache.Save(geometrycachefiles::Wmo, digest, entry);
+        }
+    }
+
+    // Doodad sets
+
+    DoodadSets.resize(placements.size());
+
+    for (size_t i = 0; i < placements.size(); ++i)
+    {
+        DoodadSets[i].reserve(placements[i].size());
+
+        for (auto const& placement : placements[i])
+        {
+            auto doodad = LoadDoodad(placement.first);
+
+            if (!!doodad->Vertices.size() && !!doodad->Indices.size())
+                DoodadSets[i].push_back(std::make_unique<WmoDoodad const>(
+                    doodad, placement.second));
+        }
+    }
+}
+
+void Wmo::ParseGroupFiles(
+    unsigned int version, int groupCount, utility::BinaryStream* reader,
+    const std::vector<std::unique_ptr<utility::BinaryStream>>& groupReaders)
+{
+    std::vector<std::unique_ptr<input::WmoGroupFile>> groupFiles;
+    groupFiles.reserve(groupCount);
+
+    for (int i = 0; i < groupCount; ++i)
+        groupFiles.push_back(std::make_unique<input::WmoGroupFile>(
+            version, version == 14 ? reader : groupReaders[i].get()));
+
     // for each group file
-    for (int g = 0; g < information.WMOGroupFilesCount; ++g)
+    for (int g = 0; g < groupCount; ++g)
     {
         Vertices.reserve(Vertices.capacity() +
                          groupFiles[g]->VerticesChunk->Vertices.size());
@@ -263,43 +403,6 @@ Wmo::Wmo(const std::string& path) : MpqPath(utility::lower(path))
                     static_cast<std::int32_t>(LiquidVertices.size() - 1));
             }
     }
-
-    // Doodad sets
-
-    input::MODS doodadSetsChunk(information.DoodadSetsCount, modsLocation,
-                                reader.get());
-    input::MODN doodadNamesChunk(information.DoodadNamesCount, modnLocation,
-                                 reader.get());
-    input::MODD doodadChunk(moddLocation, reader.get());
-
-    DoodadSets.resize(doodadSetsChunk.DoodadSets.size());
-
-    for (size_t i = 0; i < doodadSetsChunk.DoodadSets.size(); ++i)
-    {
-        auto const& set = doodadSetsChunk.DoodadSets[i];
-
-        DoodadSets[i].reserve(set.DoodadCount);
-
-        for (auto d = set.FirstDoodadIndex;
-             d < set.FirstDoodadIndex + set.DoodadCount; ++d)
-        {
-            auto const& placement = doodadChunk.Doodads[d];
-            auto const& name = doodadNamesChunk.Names[placement.NameIndex];
-
-            // TODO: figure out why this happens
-            if (name.empty())
-                continue;
-
-            math::Matrix transformMatrix;
-            placement.GetTransformMatrix(transformMatrix);
-
-            auto doodad = LoadDoodad(name);
-
-            if (!!doodad->Vertices.size() && !!doodad->Indices.size())
-                DoodadSets[i].push_back(
-                    std::make_unique<WmoDoodad const>(doodad, transformMatrix));
-        }
-    }
 }
 
 std::shared_ptr<const Doodad> Wmo::LoadDoodad(const std::string &name) const
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "parser/Wmo/WmoDoodad.hpp"
+#include "utility/BinaryStream.hpp"
 #include "utility/Vector.hpp"
 
 #include <array>
@@ -19,6 +20,12 @@ class Wmo
 private:
     std::shared_ptr<const Doodad> LoadDoodad(const std::string& name) const;
 
+    // alpha data has its groups in the root file
+    void ParseGroupFiles(
+        unsigned int version, int groupCount, utility::BinaryStream* reader,
+        const std::vector<std::unique_ptr<utility::BinaryStream>>&
+            groupReaders);
+
 public:
     const std::string MpqPath;
 
@@ -49,23 +49,21 @@ WmoInstance::WmoInstance(const Wmo* wmo, unsigned int doodadSet,
     : Bounds(bounds), TransformMatrix(transformMatrix), DoodadSet(doodadSet),
       NameSet(nameSet), Model(wmo)
 {
-    std::vector<math::Vertex> vertices;
-    std::vector<int> indices;
+    // the vertices are transformed one at a time rather than building the
+    // triangles, which is left to whoever needs them
+    for (auto const& v : Model->Vertices)
+        UpdateBounds(Bounds, TransformVertex(v), AdtChunks);
 
-    BuildTriangles(vertices, indices);
+    for (auto const& v : Model->LiquidVertices)
+        UpdateBounds(Bounds, TransformVertex(v), AdtChunks);
 
-    for (auto const& v : vertices)
-        UpdateBounds(Bounds, v, AdtChunks);
-
-    BuildLiquidTriangles(vertices, indices);
-
-    for (auto const& v : vertices)
-        UpdateBounds(Bounds, v, AdtChunks);
-
-    BuildDoodadTriangles(vertices, indices);
+    if (DoodadSet >= Model->DoodadSets.size())
+        return;
 
-    for (auto const& v : vertices)
-        UpdateBounds(Bounds, v, AdtChunks);
+    for (auto const& doodad : Model->DoodadSets[DoodadSet])
+        for (auto const& v : doodad->Parent->Vertices)
+            UpdateBounds(Bounds, TransformVertex(doodad->TransformVertex(v)),
+                         AdtChunks);
 }
 
 math::Vertex WmoInstance::TransformVertex(const math::Vertex& vertex) const
@@ -1,70 +1,102 @@
 #include "BVH.hpp"
 
+#include "Common.hpp"
 #include "utility/BinaryStream.hpp"
 #include "utility/Exception.hpp"
 
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
 namespace pathfind
 {
-BVH::BVH(const fs::path& path) : m_dataPath(path)
+BVH::BVH(const fs::path& path)
+    : m_bvhPath(path / "BVH"), m_models(nullptr), m_obstacles(nullptr),
+      m_strings(nullptr), m_modelCount(0), m_obstacleCount(0)
 {
-    auto const index_file = m_dataPath / "BVH" / "bvh.idx";
+    auto const index_file = m_bvhPath / "bvh.idx";
 
     if (!fs::is_regular_file(index_file))
         THROW(Result::BVH_INDEX_FILE_NOT_FOUND);
 
     utility::BinaryStream index(index_file);
 
-    std::uint32_t num_bvh, num_obstacles;
-    index >> num_bvh;
+    bvhfiles::IndexHeader header;
+    index >> header;
 
-    for (auto i = 0u; i < num_bvh; ++i)
-    {
-        std::uint32_t length;
-        index >> length;
+    if (header.signature != bvhfiles::IndexSignature)
+        THROW(Result::INCORRECT_FILE_SIGNATURE);
 
-        auto const mpq_path = index.ReadString(length);
+    if (header.version != bvhfiles::IndexVersion)
+        THROW(Result::INCORRECT_FILE_VERSION);
 
-        index >> length;
+    auto const size = header.modelCount * sizeof(bvhfiles::Model) +
+                      header.obstacleCount * sizeof(bvhfiles::Obstacle) +
+                      header.stringsSize;
 
-        auto const bvh_path = index.ReadString(length);
+    // the records are used in place, with no per entry parsing
+    m_index.resize(size);
+    if (size)
+        index.ReadBytes(&m_index[0], size);
 
-        m_files[mpq_path] = bvh_path;
-    }
+    auto const data = m_index.data();
 
-    index >> num_obstacles;
+    m_modelCount = header.modelCount;
+    m_obstacleCount = header.obstacleCount;
+    m_models = reinterpret_cast<const bvhfiles::Model*>(data);
+    m_obstacles = reinterpret_cast<const bvhfiles::Obstacle*>(
+        data + m_modelCount * sizeof(bvhfiles::Model));
+    m_strings = reinterpret_cast<const char*>(
+        data + m_modelCount * sizeof(bvhfiles::Model) +
+        m_obstacleCount * sizeof(bvhfiles::Obstacle));
+}
 
-    for (auto i = 0u; i < num_obstacles; ++i)
-    {
-        std::uint32_t entry, length;
+std::shared_ptr<const BVH> BVH::Load(const fs::path& path)
+{
+    static std::mutex mutex;
+    static std::unordered_map<std::string, std::weak_ptr<const BVH>> loaded;
 
-        index >> entry >> length;
+    auto const key = fs::absolute(path).lexically_normal().string();
 
-        m_temporaryObstacles[entry] = index.ReadString(length);
-    }
-}
+    std::lock_guard<std::mutex> guard(mutex);
 
-std::string BVH::GetBVHPath(const std::string& mpq_path) const
-{
-    auto const result = m_files.find(mpq_path);
+    auto& entry = loaded[key];
 
-    if (result == m_files.end())
-        THROW(Result::REQUESTED_BVH_NOT_FOUND);
+    if (auto existing = entry.lock())
+        return existing;
 
-    return (m_dataPath / "BVH" / result->second).string();
+    auto result = std::make_shared<const BVH>(path);
+    entry = result;
+
+    return result;
 }
 
-std::string BVH::GetBVHPath(std::uint32_t entry) const
+std::uint32_t BVH::GetModelId(std::uint32_t displayId) const
 {
-    auto const result = m_temporaryObstacles.find(entry);
-
-    if (result == m_temporaryObstacles.end())
+    auto const end = m_obstacles + m_obstacleCount;
+    auto const result = std::lower_bound(
+        m_obstacles, end, displayId,
+        [](const bvhfiles::Obstacle& obstacle, std::uint32_t displayId) {
+            return obstacle.displayId < displayId;
+        });
+
+    if (result == end || result->displayId != displayId)
         THROW(Result::REQUESTED_BVH_NOT_FOUND);
 
-    return (m_dataPath / "BVH" / result->second).string();
+    return result->modelId;
 }
 
-std::string BVH::GetMPQPath(std::uint32_t entry) const
+fs::path BVH::GetBVHPath(std::uint32_t modelId) const
 {
-    return "";
+    if (modelId >= m_modelCount)
+        THROW(Result::REQUESTED_BVH_NOT_FOUND);
+
+    auto const& model = m_models[modelId];
+
+    return m_bvhPath / std::string(m_strings + model.bvhFileOffset,
+                                   model.bvhFileLength);
 }
-} // namespace pathfind
\ No newline at end of file
+} // namespace pathfind
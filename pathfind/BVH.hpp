@@ -1,31 +1,46 @@
 #pragma once
 
+#include "Common.hpp"
+
 #include <cstdint>
 #include <filesystem>
-#include <string>
-#include <unordered_map>
+#include <memory>
+#include <vector>
 
 namespace fs = std::filesystem;
 
 namespace pathfind
 {
+// the index of model files, shared by every map using the same data path.
+// lookups are by integer id and do not allocate, except for building the path
+// of a model file which is about to be read
 class BVH
 {
 private:
-    const fs::path m_dataPath;
+    const fs::path m_bvhPath;
 
-    // map mpq path to .bvh path
-    std::unordered_map<std::string, std::string> m_files;
+    // the index file as it is stored on disk
+    std::vector<std::uint8_t> m_index;
 
-    // map gameobject display id to .bvh path
-    std::unordered_map<int, std::string> m_temporaryObstacles;
+    const bvhfiles::Model* m_models;
+    const bvhfiles::Obstacle* m_obstacles;
+    const char* m_strings;
+    std::uint32_t m_modelCount;
+    std::uint32_t m_obstacleCount;
 
 public:
     BVH(const fs::path& path);
+    BVH(const BVH&) = delete;
+
+    // the index is loaded once per process, and is reloaded only once every
+    // map using it has been destroyed
+    static std::shared_ptr<const BVH> Load(const fs::path& path);
+
+    std::uint32_t ModelCount() const { return m_modelCount; }
 
-    std::string GetBVHPath(const std::string& mpq_path) const;
-    std::string GetBVHPath(std::uint32_t entry) const;
+    // returns the model id for a gameobject display id
+    std::uint32_t GetModelId(std::uint32_t displayId) const;
 
-    std::string GetMPQPath(std::uint32_t entry) const;
+    fs::path GetBVHPath(std::uint32_t modelId) const;
 };
-} // namespace pathfind
\ No newline at end of file
+} // namespace pathfind
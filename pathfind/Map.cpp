@@ -29,24 +29,6 @@ static_assert(sizeof(char) == 1, "char must be one byte");
 static constexpr unsigned int GlobalWmoId = 0xFFFFFFFF;
 
 #pragma pack(push, 1)
-struct WmoFileInstance
-{
-    std::uint32_t m_id;
-    std::uint16_t m_doodadSet;
-    std::uint16_t m_nameSet;
-    float m_transformMatrix[16];
-    math::BoundingBox m_bounds;
-    char m_fileName[MeshSettings::MaxMPQPathLength];
-};
-
-struct DoodadFileInstance
-{
-    std::uint32_t m_id;
-    float m_transformMatrix[16];
-    math::BoundingBox m_bounds;
-    char m_fileName[MeshSettings::MaxMPQPathLength];
-};
-
 struct NavFileHeader
 {
     std::uint32_t sig;
@@ -82,6 +64,66 @@ struct NavFileHeader
 
 namespace {
 
+// the file stores only the top three rows of the inverse, since the bottom
+// row of an affine transform is always (0, 0, 0, 1)
+math::Matrix AffineFromArray(const float* in)
+{
+    math::Matrix result(4, 4);
+
+    for (auto row = 0; row < 3; ++row)
+        for (auto column = 0; column < 4; ++column)
+            result[row][column] = in[row * 4 + column];
+
+    result[3][0] = result[3][1] = result[3][2] = 0.f;
+    result[3][3] = 1.f;
+
+    return result;
+}
+
+pathfind::WmoInstance CreateInstance(const pathfind::WmoFileInstance& wmo)
+{
+    pathfind::WmoInstance ins;
+
+    ins.m_doodadSet = static_cast<unsigned int>(wmo.m_doodadSet);
+    ins.m_nameSet = static_cast<unsigned int>(wmo.m_nameSet);
+    ins.m_transformMatrix = math::Matrix::CreateFromArray(
+        wmo.m_transformMatrix,
+        sizeof(wmo.m_transformMatrix) / sizeof(wmo.m_transformMatrix[0]));
+    ins.m_inverseTransformMatrix =
+        AffineFromArray(wmo.m_inverseTransformMatrix);
+    ins.m_bounds = wmo.m_bounds;
+    ins.m_modelId = wmo.m_modelId;
+
+    return ins;
+}
+
+pathfind::DoodadInstance
+CreateInstance(const pathfind::DoodadFileInstance& doodad)
+{
+    pathfind::DoodadInstance ins;
+
+    ins.m_transformMatrix = math::Matrix::CreateFromArray(
+        doodad.m_transformMatrix,
+        sizeof(doodad.m_transformMatrix) / sizeof(doodad.m_transformMatrix[0]));
+    ins.m_inverseTransformMatrix =
+        AffineFromArray(doodad.m_inverseTransformMatrix);
+    ins.m_bounds = doodad.m_bounds;
+    ins.m_modelId = doodad.m_modelId;
+
+    return ins;
+}
+
+// the instance tables are sorted by id
+template <typename T>
+const T* FindFileInstance(const std::vector<T>& instances, std::uint32_t id)
+{
+    auto const i = std::lower_bound(
+        instances.cbegin(), instances.cend(), id,
+        [](const T& instance, std::uint32_t id) { return instance.m_id < id; });
+
+    return i == instances.cend() || i->m_id != id ? nullptr : &*i;
+}
+
 float random_between_0_and_1() {
     std::random_device rd;
     std::mt19937 gen(rd());
@@ -95,9 +137,16 @@ float random_between_0_and_1() {
 namespace pathfind
 {
 Map::Map(const std::filesystem::path& dataPath, const std::string& mapName)
-    : m_dataPath(dataPath), m_bvhLoader(dataPath), m_mapName(mapName),
-      m_globalWmoOriginX(0.f), m_globalWmoOriginY(0.f)
+    : m_dataPath(dataPath), m_bvhLoader(BVH::Load(dataPath)),
+      m_mapName(mapName),
+      m_globalWmoOriginX(0.f), m_globalWmoOriginY(0.f),
+      m_polyPathScratch(MaxPathHops), m_straightPathScratch(MaxPathHops * 3),
+      m_slicedQueryActive(false), m_nextPathRequestId(1),
+      m_hierarchicalPaths(0), m_tileVersion(0), m_obstacleWorkers(0)
 {
+    m_loadedWmoModels.resize(m_bvhLoader->ModelCount());
+    m_loadedDoodadModels.resize(m_bvhLoader->ModelCount());
+
     utility::BinaryStream in(m_dataPath / (mapName + ".map"));
 
     std::uint32_t magic;
@@ -148,61 +197,23 @@ Map::Map(const std::filesystem::path& dataPath, const std::string& mapName)
         auto const result = m_navMesh.init(&params);
         assert(result == DT_SUCCESS);
 
+        // the instance tables are read as they are.  instances are created
+        // from them only as tiles referencing them are loaded
         std::uint32_t wmoInstanceCount;
         in >> wmoInstanceCount;
 
+        m_wmoFileInstances.resize(wmoInstanceCount);
         if (wmoInstanceCount)
-        {
-            std::vector<WmoFileInstance> wmoInstances(wmoInstanceCount);
-            in.ReadBytes(&wmoInstances[0],
+            in.ReadBytes(&m_wmoFileInstances[0],
                          wmoInstanceCount * sizeof(WmoFileInstance));
 
-            for (auto const& wmo : wmoInstances)
-            {
-                WmoInstance ins;
-
-                ins.m_doodadSet = static_cast<unsigned int>(wmo.m_doodadSet);
-                ins.m_nameSet = static_cast<unsigned int>(wmo.m_nameSet);
-                ins.m_transformMatrix = math::Matrix::CreateFromArray(
-                    wmo.m_transformMatrix,
-                    sizeof(wmo.m_transformMatrix) /
-                        sizeof(wmo.m_transformMatrix[0]));
-                ins.m_inverseTransformMatrix =
-                    ins.m_transformMatrix.ComputeInverse();
-                ins.m_bounds = wmo.m_bounds;
-                ins.m_modelFilename = wmo.m_fileName;
-
-                m_staticWmos.insert({static_cast<unsigned int>(wmo.m_id), ins});
-            }
-        }
-
         std::uint32_t doodadInstanceCount;
         in >> doodadInstanceCount;
 
+        m_doodadFileInstances.resize(doodadInstanceCount);
         if (doodadInstanceCount)
-        {
-            std::vector<DoodadFileInstance> doodadInstances(
-                doodadInstanceCount);
-            in.ReadBytes(&doodadInstances[0],
+            in.ReadBytes(&m_doodadFileInstances[0],
                          doodadInstanceCount * sizeof(DoodadFileInstance));
-
-            for (auto const& doodad : doodadInstances)
-            {
-                DoodadInstance ins;
-
-                ins.m_transformMatrix = math::Matrix::CreateFromArray(
-                    doodad.m_transformMatrix,
-                    sizeof(doodad.m_transformMatrix) /
-                        sizeof(doodad.m_transformMatrix[0]));
-                ins.m_inverseTransformMatrix =
-                    ins.m_transformMatrix.ComputeInverse();
-                ins.m_bounds = doodad.m_bounds;
-                ins.m_modelFilename = doodad.m_fileName;
-
-                m_staticDoodads.insert(
-                    {static_cast<unsigned int>(doodad.m_id), ins});
-            }
-        }
     }
     else
     {
@@ -213,18 +224,9 @@ Map::Map(const std::filesystem::path& dataPath, const std::string& mapName)
         WmoFileInstance globalWmo;
         in >> globalWmo;
 
-        WmoInstance ins;
+        auto ins = CreateInstance(globalWmo);
 
-        ins.m_doodadSet = globalWmo.m_doodadSet;
-        ins.m_nameSet = globalWmo.m_nameSet;
-        ins.m_transformMatrix = math::Matrix::CreateFromArray(
-            globalWmo.m_transformMatrix,
-            sizeof(globalWmo.m_transformMatrix) /
-                sizeof(globalWmo.m_transformMatrix[0]));
-        ins.m_inverseTransformMatrix = ins.m_transformMatrix.ComputeInverse();
-        ins.m_bounds = globalWmo.m_bounds;
-
-        auto model = EnsureWmoModelLoaded(globalWmo.m_fileName);
+        auto model = EnsureWmoModelLoaded(globalWmo.m_modelId);
         ins.m_model = model;
 
         m_staticWmos.insert({GlobalWmoId, ins});
@@ -281,21 +283,30 @@ Map::Map(const std::filesystem::path& dataPath, const std::string& mapName)
 
     if (m_navQuery.init(&m_navMesh, 65535) != DT_SUCCESS)
         THROW(Result::DTNAVMESHQUERY_INIT_FAILED);
+
+    m_portalGraph.Load(m_dataPath / (mapName + ".graph"));
 }
 
 std::shared_ptr<WmoModel> Map::LoadModelForWmoInstance(unsigned int instanceId)
 {
-    auto const instance = m_staticWmos.find(instanceId);
+    auto instance = m_staticWmos.find(instanceId);
 
-    // ensure it exists.  this should never fail
     if (instance == m_staticWmos.end())
-        THROW(Result::UNKNOWN_WMO_INSTANCE_REQUESTED);
+    {
+        auto const file = FindFileInstance(m_wmoFileInstances, instanceId);
+
+        // ensure it exists.  this should never fail
+        if (!file)
+            THROW(Result::UNKNOWN_WMO_INSTANCE_REQUESTED);
+
+        instance = m_staticWmos.insert({instanceId, CreateInstance(*file)}).first;
+    }
 
     // if the model is loaded, return it
     if (!instance->second.m_model.expired())
         return instance->second.m_model.lock();
 
-    auto model = EnsureWmoModelLoaded(instance->second.m_modelFilename);
+    auto model = EnsureWmoModelLoaded(instance->second.m_modelId);
 
     instance->second.m_model = model;
 
@@ -305,56 +316,63 @@ std::shared_ptr<WmoModel> Map::LoadModelForWmoInstance(unsigned int instanceId)
 std::shared_ptr<DoodadModel>
 Map::LoadModelForDoodadInstance(unsigned int instanceId)
 {
-    auto const instance = m_staticDoodads.find(instanceId);
+    auto instance = m_staticDoodads.find(instanceId);
 
-    // ensure it exists.  this should never fail
     if (instance == m_staticDoodads.end())
-        THROW(Result::UNKNOWN_DOODAD_INSTANCE_REQUESTED);
+    {
+        auto const file = FindFileInstance(m_doodadFileInstances, instanceId);
+
+        // ensure it exists.  this should never fail
+        if (!file)
+            THROW(Result::UNKNOWN_DOODAD_INSTANCE_REQUESTED);
+
+        instance =
+            m_staticDoodads.insert({instanceId, CreateInstance(*file)}).first;
+    }
 
     // if the model is loaded, return it
     if (!instance->second.m_model.expired())
         return instance->second.m_model.lock();
 
-    auto model = EnsureDoodadModelLoaded(instance->second.m_modelFilename);
+    auto model = EnsureDoodadModelLoaded(instance->second.m_modelId);
 
     instance->second.m_model = model;
 
     return model;
 }
 
-std::shared_ptr<DoodadModel>
-Map::EnsureDoodadModelLoaded(const std::string& mpq_path)
+std::shared_ptr<DoodadModel> Map::EnsureDoodadModelLoaded(std::uint32_t modelId)
 {
-    auto const bvhFilename = m_bvhLoader.GetBVHPath(mpq_path);
+    if (modelId >= m_loadedDoodadModels.size())
+        THROW(Result::REQUESTED_BVH_NOT_FOUND);
 
     // if this model is currently loaded, return it
-    auto const i = m_loadedDoodadModels.find(bvhFilename);
-    if (i != m_loadedDoodadModels.end() && !i->second.expired())
-        return i->second.lock();
+    if (auto loaded = m_loadedDoodadModels[modelId].lock())
+        return loaded;
 
     // else, load it
-    utility::BinaryStream in(bvhFilename);
+    utility::BinaryStream in(m_bvhLoader->GetBVHPath(modelId));
 
     auto model = std::make_shared<pathfind::DoodadModel>();
 
     if (!model->m_aabbTree.Deserialize(in))
         THROW(Result::COULD_NOT_DESERIALIZE_DOODAD).ErrorCode();
 
-    m_loadedDoodadModels[bvhFilename] = model;
+    m_loadedDoodadModels[modelId] = model;
     return model;
 }
 
-std::shared_ptr<WmoModel> Map::EnsureWmoModelLoaded(const std::string& mpq_path)
+std::shared_ptr<WmoModel> Map::EnsureWmoModelLoaded(std::uint32_t modelId)
 {
-    auto const bvhFilename = m_bvhLoader.GetBVHPath(mpq_path);
+    if (modelId >= m_loadedWmoModels.size())
+        THROW(Result::REQUESTED_BVH_NOT_FOUND);
 
     // if this model is currently loaded, return it
-    auto const i = m_loadedWmoModels.find(bvhFilename);
-    if (i != m_loadedWmoModels.end() && !i->second.expired())
-        return i->second.lock();
+    if (auto loaded = m_loadedWmoModels[modelId].lock())
+        return loaded;
 
     // else, load it
-    utility::BinaryStream in(bvhFilename);
+    utility::BinaryStream in(m_bvhLoader->GetBVHPath(modelId));
 
     auto model = std::make_shared<pathfind::WmoModel>();
 
@@ -397,19 +415,19 @@ std::shared_ptr<WmoModel> Map::EnsureWmoModelLoaded(const std::string& mpq_path)
 
             in >> model->m_doodadSets[set][doodad].m_bounds;
 
-            char doodadFileName[MeshSettings::MaxMPQPathLength];
-            in >> doodadFileName;
+            std::uint32_t doodadModelId;
+            in >> doodadModelId;
 
-            auto doodadModel = EnsureDoodadModelLoaded(doodadFileName);
+            auto doodadModel = EnsureDoodadModelLoaded(doodadModelId);
 
             // loaded doodads serve as reference counters for automatic unload
             model->m_loadedDoodadSets[set].push_back(doodadModel);
-            model->m_doodadSets[set][doodad].m_model =
-                m_loadedDoodadModels[doodadFileName] = doodadModel;
+            model->m_doodadSets[set][doodad].m_modelId = doodadModelId;
+            model->m_doodadSets[set][doodad].m_model = doodadModel;
         }
     }
 
-    m_loadedWmoModels[bvhFilename] = model;
+    m_loadedWmoModels[modelId] = model;
 
     return model;
 }
@@ -503,8 +521,8 @@ int Map::LoadAllADTs()
 
 std::shared_ptr<Model> Map::GetOrLoadModelByDisplayId(unsigned int displayId)
 {
-    // Get the BVH file for this display ID
-    auto const bvh_path = m_bvhLoader.GetBVHPath(displayId);
+    // Get the model for this display ID
+    auto const modelId = m_bvhLoader->GetModelId(displayId);
 
     // TODO: add logic based on mpq_path
     auto const doodad = false;
@@ -516,7 +534,7 @@ std::shared_ptr<Model> Map::GetOrLoadModelByDisplayId(unsigned int displayId)
         // if (i != m_loadedDoodadModels.end() && !i->second.expired())
         //    return i->second.lock();
 
-        return EnsureDoodadModelLoaded(bvh_path);
+        return EnsureDoodadModelLoaded(modelId);
     }
     else
     {
@@ -524,54 +542,320 @@ std::shared_ptr<Model> Map::GetOrLoadModelByDisplayId(unsigned int displayId)
         // if (i != m_loadedWmoModels.end() && !i->second.expired())
         //    return i->second.lock();
 
-        return EnsureWmoModelLoaded(bvh_path);
+        return EnsureWmoModelLoaded(modelId);
     }
 
     // return nullptr;
 }
 
-bool Map::FindPath(const math::Vertex& start, const math::Vertex& end,
-                   std::vector<math::Vertex>& output, bool allowPartial) const
+dtPolyRef Map::FindNearestPoly(const float* recastPosition) const
 {
     constexpr float extents[] = {5.f, 5.f, 5.f};
 
+    dtPolyRef result;
+    if (!(m_navQuery.findNearestPoly(recastPosition, extents, &m_queryFilter,
+                                     &result, nullptr) &
+          DT_SUCCESS))
+        return 0;
+
+    return result;
+}
+
+int Map::FindPolyPath(dtPolyRef startPolyRef, dtPolyRef endPolyRef,
+                      const float* recastStart, const float* recastEnd,
+                      bool allowPartial) const
+{
+    int pathLength;
+    auto const findPathResult = m_navQuery.findPath(
+        startPolyRef, endPolyRef, recastStart, recastEnd, &m_queryFilter,
+        &m_polyPathScratch[0], &pathLength, MaxPathHops);
+    if (!(findPathResult & DT_SUCCESS) ||
+        (!allowPartial && !!(findPathResult & DT_PARTIAL_RESULT)))
+        return 0;
+
+    return pathLength;
+}
+
+bool Map::TileRebuilt(int x, int y) const
+{
+    auto const tile = m_tiles.find({x, y});
+
+    return tile == m_tiles.end() || !tile->second->m_baseMesh;
+}
+
+std::uint32_t Map::PolyComponent(dtPolyRef ref) const
+{
+    if (!m_portalGraph.HasComponents())
+        return graphfiles::NoComponent;
+
+    const dtMeshTile* meshTile;
+    const dtPoly* poly;
+    m_navMesh.getTileAndPolyByRefUnsafe(ref, &meshTile, &poly);
+
+    // the polygons of a rebuilt tile are not those which were labeled
+    if (TileRebuilt(meshTile->header->x, meshTile->header->y))
+        return graphfiles::NoComponent;
+
+    return m_portalGraph.GetComponent(
+        meshTile->header->x, meshTile->header->y,
+        static_cast<std::uint32_t>(poly - meshTile->polys));
+}
+
+bool Map::PolysConnected(dtPolyRef a, dtPolyRef b) const
+{
+    auto const componentA = PolyComponent(a);
+    auto const componentB = PolyComponent(b);
+
+    return componentA == graphfiles::NoComponent ||
+           componentB == graphfiles::NoComponent || componentA == componentB;
+}
+
+int Map::FindHierarchicalPath(dtPolyRef startPolyRef, dtPolyRef endPolyRef,
+                              const float* recastStart, const float* recastEnd,
+                              bool allowPartial) const
+{
+    m_routeTiles.clear();
+
+    if (m_portalGraph.Empty())
+        return 0;
+
+    const dtMeshTile* startTile;
+    const dtMeshTile* endTile;
+    const dtPoly* poly;
+    m_navMesh.getTileAndPolyByRefUnsafe(startPolyRef, &startTile, &poly);
+    m_navMesh.getTileAndPolyByRefUnsafe(endPolyRef, &endTile, &poly);
+
+    auto const startCluster =
+        graphfiles::ClusterId(startTile->header->x, startTile->header->y);
+    auto const endCluster =
+        graphfiles::ClusterId(endTile->header->x, endTile->header->y);
+
+    // a flat search is cheap enough between neighboring clusters
+    auto const dx = static_cast<int>(startCluster & 0xFFFF) -
+                    static_cast<int>(endCluster & 0xFFFF);
+    auto const dy = static_cast<int>(startCluster >> 16) -
+                    static_cast<int>(endCluster >> 16);
+    if (std::abs(dx) <= 1 && std::abs(dy) <= 1)
+        return 0;
+
+    if (!m_portalGraph.FindRoute(recastStart, startCluster,
+                                 PolyComponent(startPolyRef), recastEnd,
+                                 endCluster, PolyComponent(endPolyRef),
+                                 m_portalRoute))
+        return 0;
+
+    auto fromRef = startPolyRef;
+    const float* from = recastStart;
+    auto pathLength = 0;
+
+    for (auto i = 0u; i <= m_portalRoute.size(); ++i)
+    {
+        auto const lastLeg = i == m_portalRoute.size();
+
+        dtPolyRef toRef;
+        const float* to;
+
+        if (lastLeg)
+        {
+            toRef = endPolyRef;
+            to = recastEnd;
+        }
+        else
+        {
+            auto const& portal = m_portalGraph.GetNode(m_portalRoute[i]);
+            auto const& portalPoly = portal.polys[0];
+
+            // the polygon indices and positions of the graph are only those
+            // of the tiles as they were built
+            if (TileRebuilt(portalPoly.tileX, portalPoly.tileY))
+                return 0;
+
+            auto const tile =
+                m_navMesh.getTileAt(portalPoly.tileX, portalPoly.tileY, 0);
+
+            // the route crosses a tile which is not loaded
+            if (!tile || static_cast<int>(portalPoly.poly) >=
+                             tile->header->polyCount)
+                return 0;
+
+            toRef = m_navMesh.getPolyRefBase(tile) | portalPoly.poly;
+            to = portal.position;
+        }
+
+        // only the last leg may end short of its goal.  each portal is
+        // reachable from the one before it, or the route would not exist
+        auto const legPartial = lastLeg && allowPartial;
+
+        auto const polyPathLength =
+            FindPolyPath(fromRef, toRef, from, to, legPartial);
+        if (!polyPathLength)
+            return 0;
+
+        // a leg through a tile holding a temporary obstacle may pass through
+        // the obstacle where the flat search would go around it
+        auto const firstNewTile = m_routeTiles.size();
+        AddCorridorTiles(polyPathLength, m_routeTiles);
+
+        for (auto t = firstNewTile; t < m_routeTiles.size(); ++t)
+            if (TileRebuilt(m_routeTiles[t].x, m_routeTiles[t].y))
+                return 0;
+
+        // each leg begins where the previous one ended, so the shared point
+        // is overwritten
+        auto const offset = pathLength > 0 ? pathLength - 1 : 0;
+
+        int legLength;
+        auto const findStraightPathResult = m_navQuery.findStraightPath(
+            from, to, &m_polyPathScratch[0], polyPathLength,
+            &m_straightPathScratch[offset * 3], nullptr, nullptr, &legLength,
+            MaxPathHops - offset);
+        if (!(findStraightPathResult & DT_SUCCESS) ||
+            (!legPartial && !!(findStraightPathResult & DT_PARTIAL_RESULT)) ||
+            dtStatusDetail(findStraightPathResult, DT_BUFFER_TOO_SMALL))
+            return 0;
+
+        pathLength = offset + legLength;
+        fromRef = toRef;
+        from = to;
+    }
+
+    ++m_hierarchicalPaths;
+
+    return pathLength;
+}
+
+const PathCache::Entry* Map::FindCachedPath(const PathCache::Key& key) const
+{
+    return m_pathCache.Find(key, [this](const PathCache::Entry& entry) {
+        for (auto const& tile : entry.tiles)
+        {
+            auto const i = m_tiles.find({tile.x, tile.y});
+
+            // the tile has since been unloaded or rebuilt
+            if (i == m_tiles.end() || i->second->m_version != tile.version)
+                return false;
+        }
+
+        return true;
+    });
+}
+
+void Map::AddCorridorTiles(int polyPathLength,
+                           std::vector<PathCache::TileVersion>& tiles) const
+{
+    for (auto i = 0; i < polyPathLength; ++i)
+    {
+        const dtMeshTile* meshTile;
+        const dtPoly* poly;
+        m_navMesh.getTileAndPolyByRefUnsafe(m_polyPathScratch[i], &meshTile,
+                                            &poly);
+
+        auto const x = meshTile->header->x;
+        auto const y = meshTile->header->y;
+
+        if (std::any_of(tiles.cbegin(), tiles.cend(),
+                        [x, y](const PathCache::TileVersion& tile) {
+                            return tile.x == x && tile.y == y;
+                        }))
+            continue;
+
+        auto const tile = m_tiles.find({x, y});
+        assert(tile != m_tiles.end());
+
+        tiles.push_back({x, y, tile->second->m_version});
+    }
+}
+
+void Map::CachePath(const PathCache::Key& key, int polyPathLength,
+                    std::vector<math::Vertex>&& path) const
+{
+    PathCache::Entry entry;
+
+    entry.path = std::move(path);
+    AddCorridorTiles(polyPathLength, entry.tiles);
+
+    m_pathCache.Insert(key, std::move(entry));
+}
+
+void Map::CachePath(const PathCache::Key& key,
+                    const std::vector<PathCache::TileVersion>& tiles,
+                    std::vector<math::Vertex>&& path) const
+{
+    PathCache::Entry entry;
+
+    entry.path = std::move(path);
+    entry.tiles = tiles;
+
+    m_pathCache.Insert(key, std::move(entry));
+}
+
+void Map::SetPathCacheCapacity(std::size_t capacity, float quantization)
+{
+    m_pathCache.SetCapacity(capacity, quantization);
+}
+
+bool Map::FindPath(const math::Vertex& start, const math::Vertex& end,
+                   std::vector<math::Vertex>& output, bool allowPartial) const
+{
     float recastStart[3];
     float recastEnd[3];
 
     math::Convert::VertexToRecast(start, recastStart);
     math::Convert::VertexToRecast(end, recastEnd);
 
-    dtPolyRef startPolyRef, endPolyRef;
-    if (!(m_navQuery.findNearestPoly(recastStart, extents, &m_queryFilter,
-                                     &startPolyRef, nullptr) &
-          DT_SUCCESS))
-        return false;
-
+    auto const startPolyRef = FindNearestPoly(recastStart);
     if (!startPolyRef)
         return false;
 
-    if (!(m_navQuery.findNearestPoly(recastEnd, extents, &m_queryFilter,
-                                     &endPolyRef, nullptr) &
-          DT_SUCCESS))
+    auto const endPolyRef = FindNearestPoly(recastEnd);
+    if (!endPolyRef)
         return false;
 
-    if (!endPolyRef)
+    // a partial path may still be returned for disconnected polygons
+    if (!allowPartial && !PolysConnected(startPolyRef, endPolyRef))
         return false;
 
-    dtPolyRef polyRefBuffer[MaxPathHops];
+    PathCache::Key cacheKey;
+    if (m_pathCache.Enabled())
+    {
+        cacheKey = m_pathCache.MakeKey(startPolyRef, endPolyRef, start, end,
+                                       allowPartial);
 
-    int pathLength;
-    auto const findPathResult = m_navQuery.findPath(
-        startPolyRef, endPolyRef, recastStart, recastEnd, &m_queryFilter,
-        polyRefBuffer, &pathLength, MaxPathHops);
-    if (!(findPathResult & DT_SUCCESS) ||
-        (!allowPartial && !!(findPathResult & DT_PARTIAL_RESULT)))
+        if (auto const cached = FindCachedPath(cacheKey))
+        {
+            output = cached->path;
+            return true;
+        }
+    }
+
+    if (auto const hierarchicalLength =
+            FindHierarchicalPath(startPolyRef, endPolyRef, recastStart,
+                                 recastEnd, allowPartial))
+    {
+        output.resize(hierarchicalLength);
+
+        for (auto i = 0; i < hierarchicalLength; ++i)
+            math::Convert::VertexToWow(&m_straightPathScratch[i * 3],
+                                       output[i]);
+
+        if (m_pathCache.Enabled())
+            CachePath(cacheKey, m_routeTiles,
+                      std::vector<math::Vertex>(output.cbegin(),
+                                                output.cend()));
+
+        return true;
+    }
+
+    auto const polyPathLength = FindPolyPath(
+        startPolyRef, endPolyRef, recastStart, recastEnd, allowPartial);
+    if (!polyPathLength)
         return false;
 
-    float pathBuffer[MaxPathHops * 3];
+    int pathLength;
     auto const findStraightPathResult = m_navQuery.findStraightPath(
-        recastStart, recastEnd, polyRefBuffer, pathLength, pathBuffer, nullptr,
-        nullptr, &pathLength, MaxPathHops);
+        recastStart, recastEnd, &m_polyPathScratch[0], polyPathLength,
+        &m_straightPathScratch[0], nullptr, nullptr, &pathLength,
+        MaxPathHops);
     if (!(findStraightPathResult & DT_SUCCESS) ||
         (!allowPartial && !!(findStraightPathResult & DT_PARTIAL_RESULT)))
         return false;
@@ -579,7 +863,161 @@ bool Map::FindPath(const math::Vertex& start, const math::Vertex& end,
     output.resize(pathLength);
 
     for (auto i = 0; i < pathLength; ++i)
-        math::Convert::VertexToWow(&pathBuffer[i * 3], output[i]);
+        math::Convert::VertexToWow(&m_straightPathScratch[i * 3], output[i]);
+
+    if (m_pathCache.Enabled())
+        CachePath(cacheKey, polyPathLength,
+                  std::vector<math::Vertex>(output.cbegin(), output.cend()));
+
+    return true;
+}
+
+bool Map::FindPath(const math::Vertex& start, const math::Vertex& end,
+                   math::Vertex* output, std::size_t outputLength,
+                   std::size_t& pathLength, bool allowPartial) const
+{
+    static_assert(sizeof(math::Vertex) == 3 * sizeof(float),
+                  "math::Vertex must be layout compatible with float[3]");
+
+    pathLength = 0;
+
+    float recastStart[3];
+    float recastEnd[3];
+
+    math::Convert::VertexToRecast(start, recastStart);
+    math::Convert::VertexToRecast(end, recastEnd);
+
+    auto const startPolyRef = FindNearestPoly(recastStart);
+    if (!startPolyRef)
+        return false;
+
+    auto const endPolyRef = FindNearestPoly(recastEnd);
+    if (!endPolyRef)
+        return false;
+
+    // a partial path may still be returned for disconnected polygons
+    if (!allowPartial && !PolysConnected(startPolyRef, endPolyRef))
+        return false;
+
+    PathCache::Key cacheKey;
+    if (m_pathCache.Enabled())
+    {
+        cacheKey = m_pathCache.MakeKey(startPolyRef, endPolyRef, start, end,
+                                       allowPartial);
+
+        if (auto const cached = FindCachedPath(cacheKey))
+        {
+            pathLength = cached->path.size();
+
+            if (pathLength > outputLength)
+                return false;
+
+            std::copy(cached->path.cbegin(), cached->path.cend(), output);
+            return true;
+        }
+    }
+
+    if (auto const hierarchicalLength =
+            FindHierarchicalPath(startPolyRef, endPolyRef, recastStart,
+                                 recastEnd, allowPartial))
+    {
+        pathLength = static_cast<std::size_t>(hierarchicalLength);
+
+        // as below, the path is cached even when the buffer is too small
+        if (m_pathCache.Enabled())
+        {
+            std::vector<math::Vertex> path(pathLength);
+
+            for (auto i = 0; i < hierarchicalLength; ++i)
+                math::Convert::VertexToWow(&m_straightPathScratch[i * 3],
+                                           path[i]);
+
+            CachePath(cacheKey, m_routeTiles, std::move(path));
+        }
+
+        if (pathLength > outputLength)
+            return false;
+
+        for (auto i = 0; i < hierarchicalLength; ++i)
+            math::Convert::VertexToWow(&m_straightPathScratch[i * 3],
+                                       output[i]);
+
+        return true;
+    }
+
+    auto const polyPathLength = FindPolyPath(
+        startPolyRef, endPolyRef, recastStart, recastEnd, allowPartial);
+    if (!polyPathLength)
+        return false;
+
+    // the straight path has at most one more hop than the polygon corridor.
+    // detour flags a completely full buffer as too small, so when the
+    // caller's buffer has room for that many plus one, we can write into it
+    // directly and convert in place.  this bound is the only check made
+    // before the straight path is built.  its exact length, which a caller
+    // with a smaller buffer is told, is not known until then
+    auto const maxStraightPathLength =
+        static_cast<std::size_t>(polyPathLength) + 1;
+    if (outputLength > maxStraightPathLength)
+    {
+        auto const recastOutput = reinterpret_cast<float*>(output);
+
+        int straightPathLength;
+        auto const findStraightPathResult = m_navQuery.findStraightPath(
+            recastStart, recastEnd, &m_polyPathScratch[0], polyPathLength,
+            recastOutput, nullptr, nullptr, &straightPathLength,
+            static_cast<int>(maxStraightPathLength + 1));
+        if (!(findStraightPathResult & DT_SUCCESS) ||
+            (!allowPartial &&
+             !!(findStraightPathResult & DT_PARTIAL_RESULT)))
+            return false;
+
+        if (!dtStatusDetail(findStraightPathResult, DT_BUFFER_TOO_SMALL))
+        {
+            for (auto i = 0; i < straightPathLength; ++i)
+                math::Convert::VertexToWow(&recastOutput[i * 3], output[i]);
+
+            pathLength = static_cast<std::size_t>(straightPathLength);
+
+            if (m_pathCache.Enabled())
+                CachePath(cacheKey, polyPathLength,
+                          std::vector<math::Vertex>(output,
+                                                    output + pathLength));
+
+            return true;
+        }
+    }
+
+    // otherwise, build the path in the scratch buffer first so that the exact
+    // length is known before anything is written to the output
+    int straightPathLength;
+    auto const findStraightPathResult = m_navQuery.findStraightPath(
+        recastStart, recastEnd, &m_polyPathScratch[0], polyPathLength,
+        &m_straightPathScratch[0], nullptr, nullptr, &straightPathLength,
+        MaxPathHops);
+    if (!(findStraightPathResult & DT_SUCCESS) ||
+        (!allowPartial && !!(findStraightPathResult & DT_PARTIAL_RESULT)))
+        return false;
+
+    pathLength = static_cast<std::size_t>(straightPathLength);
+
+    // caching the path even when the buffer is too small makes the caller's
+    // retry with a larger buffer cheap
+    if (m_pathCache.Enabled())
+    {
+        std::vector<math::Vertex> path(pathLength);
+
+        for (auto i = 0; i < straightPathLength; ++i)
+            math::Convert::VertexToWow(&m_straightPathScratch[i * 3], path[i]);
+
+        CachePath(cacheKey, polyPathLength, std::move(path));
+    }
+
+    if (pathLength > outputLength)
+        return false;
+
+    for (auto i = 0; i < straightPathLength; ++i)
+        math::Convert::VertexToWow(&m_straightPathScratch[i * 3], output[i]);
 
     return true;
 }
@@ -780,6 +1218,26 @@ bool Map::FindPointInBetweenVectors(const math::Vertex& start, const math::Verte
     return true;
 }
 
+bool Map::AreConnected(const math::Vertex& start,
+                       const math::Vertex& end) const
+{
+    float recastStart[3];
+    float recastEnd[3];
+
+    math::Convert::VertexToRecast(start, recastStart);
+    math::Convert::VertexToRecast(end, recastEnd);
+
+    auto const startPolyRef = FindNearestPoly(recastStart);
+    if (!startPolyRef)
+        return false;
+
+    auto const endPolyRef = FindNearestPoly(recastEnd);
+    if (!endPolyRef)
+        return false;
+
+    return PolysConnected(startPolyRef, endPolyRef);
+}
+
 bool Map::FindRandomPointAroundCircle(const math::Vertex& centerPosition,
                                       const float radius,
                                       math::Vertex& randomPoint) const
@@ -3,12 +3,17 @@
 #include "BVH.hpp"
 #include "Common.hpp"
 #include "Model.hpp"
+#include "PathCache.hpp"
+#include "PortalGraph.hpp"
 #include "Tile.hpp"
 #include "recastnavigation/Detour/Include/DetourNavMesh.h"
 #include "recastnavigation/Detour/Include/DetourNavMeshQuery.h"
 #include "utility/Ray.hpp"
 #include "utility/Vector.hpp"
+#include "utility/WorkerPool.hpp"
 
+#include <cstdint>
+#include <deque>
 #include <filesystem>
 #include <memory>
 #include <string>
@@ -29,6 +34,45 @@ struct hash<std::pair<int, int>>
 
 namespace pathfind
 {
+#pragma pack(push, 1)
+// instances as stored in the .map file, sorted by id
+struct WmoFileInstance
+{
+    std::uint32_t m_id;
+    std::uint16_t m_doodadSet;
+    std::uint16_t m_nameSet;
+    float m_transformMatrix[16];
+    float m_inverseTransformMatrix[12]; // top three rows
+    math::BoundingBox m_bounds;
+    std::uint32_t m_modelId;
+};
+
+struct DoodadFileInstance
+{
+    std::uint32_t m_id;
+    float m_transformMatrix[16];
+    float m_inverseTransformMatrix[12]; // top three rows
+    math::BoundingBox m_bounds;
+    std::uint32_t m_modelId;
+};
+#pragma pack(pop)
+
+enum class PathRequestStatus : std::uint8_t
+{
+    Unknown = 0,
+    InProgress = 1,
+    Succeeded = 2,
+    Failed = 3,
+};
+
+// reported by Map::UpdateObstacles
+struct ObstacleUpdateStatistics
+{
+    int tilesRebuilt;
+    int tilesPending;
+    float milliseconds;
+};
+
 // note that instances of this type are assumed to be thread-local, therefore
 // the type is not thread safe
 class Map
@@ -39,7 +83,7 @@ private:
     static constexpr int MaxStackedPolys = 128;
     static constexpr int MaxPathHops = 4096;
 
-    BVH m_bvhLoader;
+    std::shared_ptr<const BVH> m_bvhLoader;
 
     // this is false when the map is based on a global wmo
     bool m_hasADTs;
@@ -57,13 +101,56 @@ private:
     dtNavMeshQuery m_navQuery;
     dtQueryFilter m_queryFilter;
 
+    // scratch space for path queries.  allocated once and reused by every
+    // call so that FindPath needs neither heap allocations nor large stack
+    // frames
+    mutable std::vector<dtPolyRef> m_polyPathScratch;
+    mutable std::vector<float> m_straightPathScratch;
+
+    struct PathRequest
+    {
+        float start[3];
+        float end[3];
+        dtPolyRef startPolyRef;
+        dtPolyRef endPolyRef;
+        bool allowPartial;
+        PathRequestStatus status;
+        std::vector<math::Vertex> path;
+    };
+
+    // time-sliced path requests.  detour can only advance one sliced query at
+    // a time, so requests are serviced in the order they were submitted.  a
+    // separate query object is used because every blocking query resets the
+    // node pool of m_navQuery.  it is initialized on the first submission.
+    dtNavMeshQuery m_slicedQuery;
+    bool m_slicedQueryActive;
+    std::uint32_t m_nextPathRequestId;
+    std::unordered_map<std::uint32_t, PathRequest> m_pathRequests;
+    std::deque<std::uint32_t> m_pendingPathRequests;
+
+    mutable PathCache m_pathCache;
+
+    // optional abstract graph used to plan paths between distant clusters
+    PortalGraph m_portalGraph;
+    mutable std::vector<std::uint32_t> m_portalRoute;
+    mutable std::vector<PathCache::TileVersion> m_routeTiles;
+    mutable std::size_t m_hierarchicalPaths;
+
+    // incremented whenever a tile is loaded or rebuilt, so that cached paths
+    // through it can be recognized as stale
+    std::uint32_t m_tileVersion;
+
     // TODO: Does this need to be a pointer?
     std::unordered_map<std::pair<int, int>, std::unique_ptr<Tile>> m_tiles;
 
-    // indexed by unique instance id.  this data is always loaded.  whenever a
-    // tile using one of these instances is loaded, the corresponding model is
-    // loaded also.  whenever all tiles referencing a model (possibly through
-    // distinct instances) are unloaded, the model is unloaded.
+    // the instance tables of the .map file.  these are always loaded
+    std::vector<WmoFileInstance> m_wmoFileInstances;
+    std::vector<DoodadFileInstance> m_doodadFileInstances;
+
+    // indexed by unique instance id.  an instance is created from its table
+    // entry when a tile using it is first loaded, and the corresponding model
+    // is loaded also.  whenever all tiles referencing a model (possibly
+    // through distinct instances) are unloaded, the model is unloaded.
     std::unordered_map<std::uint32_t, WmoInstance> m_staticWmos;
     std::unordered_map<std::uint32_t, DoodadInstance> m_staticDoodads;
 
@@ -73,10 +160,26 @@ private:
     std::unordered_map<std::uint64_t, std::weak_ptr<DoodadInstance>>
         m_temporaryDoodads;
 
-    // map, by filename, of loaded models
-    std::unordered_map<std::string, std::weak_ptr<WmoModel>> m_loadedWmoModels;
-    std::unordered_map<std::string, std::weak_ptr<DoodadModel>>
-        m_loadedDoodadModels;
+    // temporary obstacles which have been added, but not yet applied to the
+    // tiles they overlap.  the instance is kept alive here until then
+    struct PendingObstacle
+    {
+        std::uint64_t guid;
+        std::shared_ptr<DoodadInstance> doodad;
+    };
+
+    std::deque<PendingObstacle> m_pendingObstacles;
+
+    // tiles whose height field has changed since their mesh was built,
+    // grouped by the obstacle change which affected them
+    std::deque<std::vector<std::pair<int, int>>> m_dirtyTileGroups;
+
+    // threads on which UpdateObstacles builds tile meshes
+    utility::WorkerPool m_obstacleWorkers;
+
+    // loaded models, indexed by model id
+    std::vector<std::weak_ptr<WmoModel>> m_loadedWmoModels;
+    std::vector<std::weak_ptr<DoodadModel>> m_loadedDoodadModels;
 
     // ensures that the model for a particular WMO instance is loaded
     std::shared_ptr<WmoModel> LoadModelForWmoInstance(unsigned int instanceId);
@@ -86,11 +189,10 @@ private:
     LoadModelForDoodadInstance(unsigned int instanceId);
 
     // ensure that the given WMO model is loaded
-    std::shared_ptr<WmoModel> EnsureWmoModelLoaded(const std::string& mpq_path);
+    std::shared_ptr<WmoModel> EnsureWmoModelLoaded(std::uint32_t modelId);
 
     // ensure that the given doodad model is loaded
-    std::shared_ptr<DoodadModel>
-    EnsureDoodadModelLoaded(const std::string& mpq_path);
+    std::shared_ptr<DoodadModel> EnsureDoodadModelLoaded(std::uint32_t modelId);
 
     const Tile* GetTile(float x, float y) const;
 
@@ -102,6 +204,59 @@ private:
     bool FindNextZ(const Tile* tile, float x, float y, float zHint,
                       bool includeAdt, float& result) const;
 
+    // returns the polygon nearest to the given (recast space) point, or zero
+    dtPolyRef FindNearestPoly(const float* recastPosition) const;
+
+    // finds the polygon corridor between the two (recast space) points and
+    // their polygons, storing it in m_polyPathScratch.  returns the number of
+    // polygons in the corridor, or zero if no path was found
+    int FindPolyPath(dtPolyRef startPolyRef, dtPolyRef endPolyRef,
+                     const float* recastStart, const float* recastEnd,
+                     bool allowPartial) const;
+
+    // true when the tile is not loaded, or its mesh may have been rebuilt
+    // around temporary obstacles.  the polygons of such a tile are not those
+    // from which the island labels and portal graph were built
+    bool TileRebuilt(int x, int y) const;
+
+    // the island of the mesh on which the polygon lies, or
+    // graphfiles::NoComponent when it is unknown
+    std::uint32_t PolyComponent(dtPolyRef ref) const;
+
+    // returns false only when the two polygons are known to lie on separate
+    // islands of the mesh, between which no path can exist
+    bool PolysConnected(dtPolyRef a, dtPolyRef b) const;
+
+    // when the start and end polygons lie in clusters which are not adjacent,
+    // plans a route over the portal graph and refines each leg of it with
+    // detour.  the (recast space) straight path is written to
+    // m_straightPathScratch, and the tiles it passes through to
+    // m_routeTiles.  only the last leg may be partial, when allowed.  returns
+    // the number of points, or zero when the portal graph is not applicable,
+    // the route crosses a rebuilt tile, or no path was found.  the caller
+    // then falls back to a flat search
+    int FindHierarchicalPath(dtPolyRef startPolyRef, dtPolyRef endPolyRef,
+                             const float* recastStart, const float* recastEnd,
+                             bool allowPartial) const;
+
+    // returns the cached path for the key, provided that none of the tiles its
+    // corridor passes through have changed since it was cached
+    const PathCache::Entry* FindCachedPath(const PathCache::Key& key) const;
+
+    // appends the tiles of the corridor in m_polyPathScratch which are not
+    // already listed
+    void AddCorridorTiles(int polyPathLength,
+                          std::vector<PathCache::TileVersion>& tiles) const;
+
+    // caches a path whose corridor is in m_polyPathScratch
+    void CachePath(const PathCache::Key& key, int polyPathLength,
+                   std::vector<math::Vertex>&& path) const;
+
+    // caches a path through the given tiles
+    void CachePath(const PathCache::Key& key,
+                   const std::vector<PathCache::TileVersion>& tiles,
+                   std::vector<math::Vertex>&& path) const;
+
     bool RayCast(math::Ray& ray, bool doodads) const;
     bool RayCast(math::Ray& ray, const std::vector<const Tile*>& tiles,
                  bool doodads, unsigned int* zone = nullptr,
@@ -133,12 +288,75 @@ public:
                        const math::Vertex& position,
                        const math::Matrix& rotation, int doodadSet = -1);
 
+    // returns false if there is no game object with the given guid.  like
+    // adding one, the affected tiles are rebuilt by UpdateObstacles
+    bool RemoveGameObject(std::uint64_t guid);
+
+    // applies the temporary obstacles added since the last call, and rebuilds
+    // about maxTiles of the tiles affected by added or removed obstacles,
+    // each of them once regardless of how many obstacles changed.  tiles are
+    // built concurrently and then swapped into the navmesh together, and all
+    // tiles touched by one obstacle are always rebuilt in the same call, which
+    // can exceed the budget.  a negative budget rebuilds every affected tile.
+    // until a tile is rebuilt, paths do not reflect its changes.
+    ObstacleUpdateStatistics UpdateObstacles(int maxTiles);
+
+    // the number of threads, including the caller, on which UpdateObstacles
+    // builds tiles.  zero, the default, uses one per core.  the threads are
+    // started on first use and kept for later calls
+    void SetObstacleThreads(std::size_t threads);
+
     std::shared_ptr<Model> GetOrLoadModelByDisplayId(unsigned int displayId);
 
     bool FindPath(const math::Vertex& start, const math::Vertex& end,
                   std::vector<math::Vertex>& output,
                   bool allowPartial = false) const;
 
+    // writes the path directly into the caller provided buffer.  when the
+    // buffer is too small, false is returned and pathLength is set to the
+    // required length, which is only known once the path has been found.  if
+    // no path exists, pathLength is zero
+    bool FindPath(const math::Vertex& start, const math::Vertex& end,
+                  math::Vertex* output, std::size_t outputLength,
+                  std::size_t& pathLength, bool allowPartial = false) const;
+
+    // enables a least recently used cache of up to capacity paths in front of
+    // FindPath.  endpoints falling into the same quantization cell (in yards)
+    // on the same polygons share a result.  a capacity of zero disables it
+    void SetPathCacheCapacity(std::size_t capacity, float quantization = 0.5f);
+    const PathCache& GetPathCache() const { return m_pathCache; }
+    void ResetPathCacheStatistics() { m_pathCache.ResetStatistics(); }
+
+    // the number of paths found by FindPath over the portal graph, rather
+    // than by a flat search
+    std::size_t HierarchicalPaths() const { return m_hierarchicalPaths; }
+
+    // queues a path request to be advanced by UpdatePaths, and returns a
+    // handle for it.  the handle is never zero.
+    std::uint32_t SubmitPath(const math::Vertex& start, const math::Vertex& end,
+                             bool allowPartial = false);
+
+    // advances queued path requests, spending at most maxIterations node
+    // expansions across all of them.  returns the number of iterations used
+    int UpdatePaths(int maxIterations);
+
+    PathRequestStatus GetPathStatus(std::uint32_t request) const;
+
+    // retrieves the result of a finished request and releases it.  returns
+    // the status of the request, and leaves unfinished requests queued
+    PathRequestStatus TakePath(std::uint32_t request,
+                               std::vector<math::Vertex>& output);
+
+    // as above, but writes the path of a successful request into the caller
+    // provided buffer.  if the buffer is too small, the request is kept and
+    // pathLength is set to the required length
+    PathRequestStatus TakePath(std::uint32_t request, math::Vertex* output,
+                               std::size_t outputLength,
+                               std::size_t& pathLength);
+
+    // discards a request, whether or not it has finished
+    void CancelPath(std::uint32_t request);
+
     // for finding height(s) at a given (x, y), there are two scenarios:
     // 1: we want to find exactly one z for a given path which has this (x, y)
     // as a hop.  in this case, there should only be one correct value,
@@ -162,6 +380,13 @@ public:
     bool LineOfSight(const math::Vertex& start, const math::Vertex& stop,
                      bool doodads) const;
 
+    // Returns false when no path between the two positions can exist, which is
+    // decided from connectivity computed when the map was built.  This is far
+    // cheaper than a failed FindPath, but a result of true does not guarantee
+    // that a path will be found.
+    bool AreConnected(const math::Vertex& start,
+                      const math::Vertex& end) const;
+
     bool FindRandomPointAroundCircle(const math::Vertex& centerPosition,
                                      float radius,
                                      math::Vertex& randomPoint) const;
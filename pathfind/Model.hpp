@@ -4,6 +4,7 @@
 #include "utility/BoundingBox.hpp"
 #include "utility/Matrix.hpp"
 
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -27,7 +28,7 @@ struct DoodadInstance
     math::Matrix m_transformMatrix;
     math::Matrix m_inverseTransformMatrix;
     math::BoundingBox m_bounds;
-    std::string m_modelFilename;
+    std::uint32_t m_modelId;
     std::vector<math::Vertex>
         m_translatedVertices; // wow coordinate space.  indices are obtained
                               // from model.
@@ -51,7 +52,7 @@ struct WmoInstance
     math::Matrix m_transformMatrix;
     math::Matrix m_inverseTransformMatrix;
     math::BoundingBox m_bounds;
-    std::string m_modelFilename;
+    std::uint32_t m_modelId;
     std::weak_ptr<WmoModel> m_model;
 };
 } // namespace pathfind
\ No newline at end of file
@@ -0,0 +1,112 @@
+#include "PathCache.hpp"
+
+#include <cmath>
+#include <functional>
+
+namespace pathfind
+{
+bool PathCache::Key::operator==(const Key& other) const
+{
+    return startPoly == other.startPoly && endPoly == other.endPoly &&
+           start[0] == other.start[0] && start[1] == other.start[1] &&
+           start[2] == other.start[2] && end[0] == other.end[0] &&
+           end[1] == other.end[1] && end[2] == other.end[2] &&
+           allowPartial == other.allowPartial;
+}
+
+std::size_t PathCache::KeyHash::operator()(const Key& key) const
+{
+    std::size_t result = std::hash<std::uint64_t>()(key.startPoly);
+
+    auto const combine = [&result](std::size_t value) {
+        result ^= value + 0x9e3779b9 + (result << 6) + (result >> 2);
+    };
+
+    combine(std::hash<std::uint64_t>()(key.endPoly));
+
+    for (auto i = 0; i < 3; ++i)
+    {
+        combine(std::hash<std::int32_t>()(key.start[i]));
+        combine(std::hash<std::int32_t>()(key.end[i]));
+    }
+
+    combine(key.allowPartial ? 1 : 0);
+
+    return result;
+}
+
+PathCache::PathCache()
+    : m_capacity(0), m_quantization(1.f), m_hits(0), m_misses(0),
+      m_invalidations(0)
+{
+}
+
+void PathCache::SetCapacity(std::size_t capacity, float quantization)
+{
+    m_capacity = capacity;
+    m_quantization = quantization > 0.f ? quantization : 1.f;
+
+    // the quantization affects every key, so existing entries are useless
+    Clear();
+}
+
+PathCache::Key PathCache::MakeKey(std::uint64_t startPoly,
+                                  std::uint64_t endPoly,
+                                  const math::Vertex& start,
+                                  const math::Vertex& end,
+                                  bool allowPartial) const
+{
+    auto const quantize = [this](float value) {
+        return static_cast<std::int32_t>(std::floor(value / m_quantization));
+    };
+
+    Key result;
+
+    result.startPoly = startPoly;
+    result.endPoly = endPoly;
+    result.start[0] = quantize(start.X);
+    result.start[1] = quantize(start.Y);
+    result.start[2] = quantize(start.Z);
+    result.end[0] = quantize(end.X);
+    result.end[1] = quantize(end.Y);
+    result.end[2] = quantize(end.Z);
+    result.allowPartial = allowPartial;
+
+    return result;
+}
+
+void PathCache::Insert(const Key& key, Entry&& entry)
+{
+    if (!m_capacity)
+        return;
+
+    auto const i = m_index.find(key);
+
+    if (i != m_index.end())
+    {
+        i->second->second = std::move(entry);
+        m_entries.splice(m_entries.begin(), m_entries, i->second);
+        return;
+    }
+
+    while (m_index.size() >= m_capacity)
+    {
+        m_index.erase(m_entries.back().first);
+        m_entries.pop_back();
+    }
+
+    m_entries.emplace_front(key, std::move(entry));
+    m_index[key] = m_entries.begin();
+}
+
+void PathCache::Clear()
+{
+    m_entries.clear();
+    m_index.clear();
+}
+
+void PathCache::ResetStatistics()
+{
+    m_hits = m_misses = m_invalidations = 0;
+}
+} // namespace pathfind
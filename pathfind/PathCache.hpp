@@ -0,0 +1,112 @@
+#pragma once
+
+#include "utility/Vector.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace pathfind
+{
+// least recently used cache of path results, keyed by the polygons and the
+// quantized positions of the path endpoints.  entries remember the version of
+// every tile their corridor passes through, so that they can be discarded
+// once any of those tiles is rebuilt or unloaded.
+class PathCache
+{
+public:
+    struct Key
+    {
+        std::uint64_t startPoly;
+        std::uint64_t endPoly;
+        std::int32_t start[3];
+        std::int32_t end[3];
+        bool allowPartial;
+
+        bool operator==(const Key& other) const;
+    };
+
+    struct TileVersion
+    {
+        int x;
+        int y;
+        std::uint32_t version;
+    };
+
+    struct Entry
+    {
+        std::vector<math::Vertex> path;
+        std::vector<TileVersion> tiles;
+    };
+
+private:
+    struct KeyHash
+    {
+        std::size_t operator()(const Key& key) const;
+    };
+
+    using EntryList = std::list<std::pair<Key, Entry>>;
+
+    std::size_t m_capacity;
+    float m_quantization;
+
+    // most recently used entries are at the front
+    EntryList m_entries;
+    std::unordered_map<Key, EntryList::iterator, KeyHash> m_index;
+
+    std::uint64_t m_hits;
+    std::uint64_t m_misses;
+    std::uint64_t m_invalidations;
+
+public:
+    PathCache();
+
+    // a capacity of zero disables the cache
+    void SetCapacity(std::size_t capacity, float quantization);
+    std::size_t Capacity() const { return m_capacity; }
+    bool Enabled() const { return m_capacity > 0; }
+
+    Key MakeKey(std::uint64_t startPoly, std::uint64_t endPoly,
+                const math::Vertex& start, const math::Vertex& end,
+                bool allowPartial) const;
+
+    // returns the entry for the given key and marks it as most recently used.
+    // entries rejected by the validator are removed.
+    template <typename Validator>
+    const Entry* Find(const Key& key, Validator&& isValid)
+    {
+        auto const i = m_index.find(key);
+
+        if (i == m_index.end())
+        {
+            ++m_misses;
+            return nullptr;
+        }
+
+        if (!isValid(i->second->second))
+        {
+            ++m_misses;
+            ++m_invalidations;
+            m_entries.erase(i->second);
+            m_index.erase(i);
+            return nullptr;
+        }
+
+        ++m_hits;
+        m_entries.splice(m_entries.begin(), m_entries, i->second);
+        return &i->second->second;
+    }
+
+    void Insert(const Key& key, Entry&& entry);
+    void Clear();
+
+    std::size_t Size() const { return m_index.size(); }
+    std::uint64_t Hits() const { return m_hits; }
+    std::uint64_t Misses() const { return m_misses; }
+    std::uint64_t Invalidations() const { return m_invalidations; }
+    void ResetStatistics();
+};
+} // namespace pathfind
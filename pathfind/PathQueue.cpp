@@ -0,0 +1,210 @@
+#include "Map.hpp"
+
+#include "Common.hpp"
+#include "recastnavigation/Detour/Include/DetourNavMesh.h"
+#include "recastnavigation/Detour/Include/DetourNavMeshQuery.h"
+#include "utility/Exception.hpp"
+#include "utility/MathHelper.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace pathfind
+{
+std::uint32_t Map::SubmitPath(const math::Vertex& start,
+                              const math::Vertex& end, bool allowPartial)
+{
+    if (!m_slicedQuery.getAttachedNavMesh() &&
+        m_slicedQuery.init(&m_navMesh, 65535) != DT_SUCCESS)
+        THROW(Result::DTNAVMESHQUERY_INIT_FAILED);
+
+    auto const id = m_nextPathRequestId++;
+
+    // zero is never a valid handle
+    if (!m_nextPathRequestId)
+        m_nextPathRequestId = 1;
+
+    auto& request = m_pathRequests[id];
+
+    math::Convert::VertexToRecast(start, request.start);
+    math::Convert::VertexToRecast(end, request.end);
+
+    request.allowPartial = allowPartial;
+    request.startPolyRef = FindNearestPoly(request.start);
+    request.endPolyRef = FindNearestPoly(request.end);
+
+    // requests which cannot possibly succeed are never queued
+    if (!request.startPolyRef || !request.endPolyRef ||
+        (!allowPartial &&
+         !PolysConnected(request.startPolyRef, request.endPolyRef)))
+    {
+        request.status = PathRequestStatus::Failed;
+        return id;
+    }
+
+    request.status = PathRequestStatus::InProgress;
+    m_pendingPathRequests.push_back(id);
+
+    return id;
+}
+
+int Map::UpdatePaths(int maxIterations)
+{
+    auto iterations = 0;
+
+    while (iterations < maxIterations && !m_pendingPathRequests.empty())
+    {
+        auto const i = m_pathRequests.find(m_pendingPathRequests.front());
+
+        // the request was cancelled while it was waiting
+        if (i == m_pathRequests.end())
+        {
+            m_pendingPathRequests.pop_front();
+            continue;
+        }
+
+        auto& request = i->second;
+
+        if (!m_slicedQueryActive)
+        {
+            auto const initResult = m_slicedQuery.initSlicedFindPath(
+                request.startPolyRef, request.endPolyRef, request.start,
+                request.end, &m_queryFilter);
+
+            if (dtStatusFailed(initResult))
+            {
+                request.status = PathRequestStatus::Failed;
+                m_pendingPathRequests.pop_front();
+                continue;
+            }
+
+            m_slicedQueryActive = true;
+        }
+
+        int done = 0;
+        auto const updateResult = m_slicedQuery.updateSlicedFindPath(
+            maxIterations - iterations, &done);
+        iterations += done;
+
+        // the budget ran out before this request finished
+        if (dtStatusInProgress(updateResult))
+            break;
+
+        m_slicedQueryActive = false;
+        m_pendingPathRequests.pop_front();
+
+        int polyPathLength = 0;
+        auto const finalizeResult = m_slicedQuery.finalizeSlicedFindPath(
+            &m_polyPathScratch[0], &polyPathLength, MaxPathHops);
+
+        if (!(finalizeResult & DT_SUCCESS) || !polyPathLength ||
+            (!request.allowPartial && !!(finalizeResult & DT_PARTIAL_RESULT)))
+        {
+            request.status = PathRequestStatus::Failed;
+            continue;
+        }
+
+        int pathLength;
+        auto const findStraightPathResult = m_navQuery.findStraightPath(
+            request.start, request.end, &m_polyPathScratch[0], polyPathLength,
+            &m_straightPathScratch[0], nullptr, nullptr, &pathLength,
+            MaxPathHops);
+        if (!(findStraightPathResult & DT_SUCCESS) ||
+            (!request.allowPartial &&
+             !!(findStraightPathResult & DT_PARTIAL_RESULT)))
+        {
+            request.status = PathRequestStatus::Failed;
+            continue;
+        }
+
+        request.path.resize(pathLength);
+
+        for (auto p = 0; p < pathLength; ++p)
+            math::Convert::VertexToWow(&m_straightPathScratch[p * 3],
+                                       request.path[p]);
+
+        request.status = PathRequestStatus::Succeeded;
+    }
+
+    return iterations;
+}
+
+PathRequestStatus Map::GetPathStatus(std::uint32_t request) const
+{
+    auto const i = m_pathRequests.find(request);
+
+    if (i == m_pathRequests.end())
+        return PathRequestStatus::Unknown;
+
+    return i->second.status;
+}
+
+PathRequestStatus Map::TakePath(std::uint32_t request,
+                                std::vector<math::Vertex>& output)
+{
+    auto const i = m_pathRequests.find(request);
+
+    if (i == m_pathRequests.end())
+        return PathRequestStatus::Unknown;
+
+    auto const status = i->second.status;
+
+    if (status == PathRequestStatus::InProgress)
+        return status;
+
+    if (status == PathRequestStatus::Succeeded)
+        output = std::move(i->second.path);
+
+    m_pathRequests.erase(i);
+
+    return status;
+}
+
+PathRequestStatus Map::TakePath(std::uint32_t request, math::Vertex* output,
+                                std::size_t outputLength,
+                                std::size_t& pathLength)
+{
+    pathLength = 0;
+
+    auto const i = m_pathRequests.find(request);
+
+    if (i == m_pathRequests.end())
+        return PathRequestStatus::Unknown;
+
+    auto const status = i->second.status;
+
+    if (status == PathRequestStatus::InProgress)
+        return status;
+
+    if (status == PathRequestStatus::Succeeded)
+    {
+        auto const& path = i->second.path;
+
+        pathLength = path.size();
+
+        if (pathLength > outputLength)
+            return status;
+
+        std::copy(path.cbegin(), path.cend(), output);
+    }
+
+    m_pathRequests.erase(i);
+
+    return status;
+}
+
+void Map::CancelPath(std::uint32_t request)
+{
+    // the pending queue is cleaned up lazily by UpdatePaths, except for the
+    // request currently being serviced, whose sliced query must be abandoned
+    if (m_slicedQueryActive && !m_pendingPathRequests.empty() &&
+        m_pendingPathRequests.front() == request)
+    {
+        m_slicedQueryActive = false;
+        m_pendingPathRequests.pop_front();
+    }
+
+    m_pathRequests.erase(request);
+}
+} // namespace pathfind
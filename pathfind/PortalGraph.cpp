@@ -0,0 +1,263 @@
+#include "PortalGraph.hpp"
+
+#include "Common.hpp"
+#include "recastnavigation/Detour/Include/DetourCommon.h"
+#include "utility/BinaryStream.hpp"
+#include "utility/Exception.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <utility>
+#include <vector>
+
+namespace pathfind
+{
+bool PortalGraph::Load(const std::filesystem::path& path)
+{
+    m_nodes.clear();
+    m_firstEdge.clear();
+    m_edges.clear();
+    m_clusterNodes.clear();
+    m_nodeComponents.clear();
+    m_components.clear();
+    m_componentParent.clear();
+
+    if (!std::filesystem::exists(path))
+        return false;
+
+    utility::BinaryStream in(path);
+
+    std::uint32_t magic, version, tilesPerCluster;
+    in >> magic >> version >> tilesPerCluster;
+
+    if (magic != graphfiles::FileSignature ||
+        version != graphfiles::FileVersion ||
+        tilesPerCluster != graphfiles::TilesPerCluster)
+        THROW(Result::INVALID_GRAPH_FILE);
+
+    std::uint32_t nodeCount;
+    in >> nodeCount;
+
+    m_nodes.resize(nodeCount);
+    if (nodeCount)
+        in.ReadBytes(&m_nodes[0], nodeCount * sizeof(graphfiles::Node));
+
+    std::uint32_t edgeCount;
+    in >> edgeCount;
+
+    m_edges.resize(edgeCount);
+    if (edgeCount)
+        in.ReadBytes(&m_edges[0], edgeCount * sizeof(graphfiles::Edge));
+
+    std::sort(m_edges.begin(), m_edges.end(),
+              [](const graphfiles::Edge& a, const graphfiles::Edge& b) {
+                  return a.from < b.from;
+              });
+
+    m_firstEdge.resize(nodeCount + 1, 0);
+    for (auto const& edge : m_edges)
+    {
+        if (edge.from >= nodeCount || edge.to >= nodeCount)
+            THROW(Result::INVALID_GRAPH_FILE);
+
+        ++m_firstEdge[edge.from + 1];
+    }
+
+    for (auto n = 0u; n < nodeCount; ++n)
+        m_firstEdge[n + 1] += m_firstEdge[n];
+
+    for (auto n = 0u; n < nodeCount; ++n)
+    {
+        m_clusterNodes[m_nodes[n].clusters[0]].push_back(n);
+        m_clusterNodes[m_nodes[n].clusters[1]].push_back(n);
+    }
+
+    std::uint32_t componentCount, tileCount;
+    in >> componentCount >> tileCount;
+
+    for (auto t = 0u; t < tileCount; ++t)
+    {
+        std::int32_t tileX, tileY;
+        std::uint32_t polyCount;
+        in >> tileX >> tileY >> polyCount;
+
+        auto& components = m_components[TileKey(tileX, tileY)];
+        components.resize(polyCount);
+
+        if (polyCount)
+            in.ReadBytes(&components[0], polyCount * sizeof(std::uint32_t));
+
+        for (auto const component : components)
+            if (component != graphfiles::NoComponent &&
+                component >= componentCount)
+                THROW(Result::INVALID_GRAPH_FILE);
+    }
+
+    m_componentParent.resize(componentCount);
+    for (auto c = 0u; c < componentCount; ++c)
+        m_componentParent[c] = c;
+
+    // both polygons of a portal are connected across the cluster border, so
+    // either one gives its component
+    m_nodeComponents.resize(nodeCount, graphfiles::NoComponent);
+    for (auto n = 0u; n < nodeCount; ++n)
+    {
+        auto const& poly = m_nodes[n].polys[0];
+        auto const i = m_components.find(TileKey(poly.tileX, poly.tileY));
+
+        if (i != m_components.end() && poly.poly < i->second.size())
+            m_nodeComponents[n] = i->second[poly.poly];
+    }
+
+    m_cost.resize(nodeCount + 2);
+    m_parent.resize(nodeCount + 2);
+
+    return true;
+}
+
+std::uint32_t PortalGraph::FindComponent(std::uint32_t component) const
+{
+    while (m_componentParent[component] != component)
+    {
+        // path halving
+        m_componentParent[component] =
+            m_componentParent[m_componentParent[component]];
+        component = m_componentParent[component];
+    }
+
+    return component;
+}
+
+std::uint32_t PortalGraph::GetComponent(int tileX, int tileY,
+                                        std::uint32_t poly) const
+{
+    auto const i = m_components.find(TileKey(tileX, tileY));
+
+    if (i == m_components.end() || poly >= i->second.size() ||
+        i->second[poly] == graphfiles::NoComponent)
+        return graphfiles::NoComponent;
+
+    return FindComponent(i->second[poly]);
+}
+
+void PortalGraph::MergeComponents(int tileX, int tileY)
+{
+    auto root = graphfiles::NoComponent;
+
+    for (auto y = tileY - 1; y <= tileY + 1; ++y)
+        for (auto x = tileX - 1; x <= tileX + 1; ++x)
+        {
+            auto const i = m_components.find(TileKey(x, y));
+
+            if (i == m_components.end())
+                continue;
+
+            for (auto const component : i->second)
+            {
+                if (component == graphfiles::NoComponent)
+                    continue;
+
+                auto const r = FindComponent(component);
+
+                if (root == graphfiles::NoComponent)
+                    root = r;
+                else if (r != root)
+                    m_componentParent[r] = root;
+            }
+        }
+}
+
+bool PortalGraph::FindRoute(const float* start, std::uint32_t startCluster,
+                            std::uint32_t startComponent, const float* end,
+                            std::uint32_t endCluster,
+                            std::uint32_t endComponent,
+                            std::vector<std::uint32_t>& route) const
+{
+    route.clear();
+
+    auto const startNodes = m_clusterNodes.find(startCluster);
+    if (startNodes == m_clusterNodes.end() ||
+        m_clusterNodes.find(endCluster) == m_clusterNodes.end())
+        return false;
+
+    // the start and goal are given the two indices after the portals
+    auto const nodeCount = static_cast<std::uint32_t>(m_nodes.size());
+    auto const source = nodeCount;
+    auto const goal = nodeCount + 1;
+
+    std::fill(m_cost.begin(), m_cost.end(),
+              (std::numeric_limits<float>::max)());
+
+    using QueueEntry = std::pair<float, std::uint32_t>;
+    std::priority_queue<QueueEntry, std::vector<QueueEntry>,
+                        std::greater<QueueEntry>>
+        open;
+
+    auto const heuristic = [this, end, goal](std::uint32_t node) {
+        return node == goal ? 0.f : dtVdist(m_nodes[node].position, end);
+    };
+
+    auto const relax = [&](std::uint32_t from, std::uint32_t to, float cost) {
+        auto const total = m_cost[from] + cost;
+
+        if (total >= m_cost[to])
+            return;
+
+        m_cost[to] = total;
+        m_parent[to] = from;
+        open.push({total + heuristic(to), to});
+    };
+
+    // a portal on another island of the cluster cannot be walked to from the
+    // start, nor can the goal be walked to from one
+    auto const reaches = [this](std::uint32_t node, std::uint32_t component) {
+        return component == graphfiles::NoComponent ||
+               m_nodeComponents[node] == graphfiles::NoComponent ||
+               FindComponent(m_nodeComponents[node]) == component;
+    };
+
+    m_cost[source] = 0.f;
+
+    for (auto const node : startNodes->second)
+        if (reaches(node, startComponent))
+            relax(source, node, dtVdist(start, m_nodes[node].position));
+
+    while (!open.empty())
+    {
+        auto const current = open.top();
+        open.pop();
+
+        auto const node = current.second;
+
+        if (node == goal)
+            break;
+
+        // skip entries superseded by a cheaper path
+        if (current.first > m_cost[node] + heuristic(node))
+            continue;
+
+        for (auto e = m_firstEdge[node]; e < m_firstEdge[node + 1]; ++e)
+            relax(node, m_edges[e].to, m_edges[e].cost);
+
+        auto const& portal = m_nodes[node];
+        if ((portal.clusters[0] == endCluster ||
+             portal.clusters[1] == endCluster) &&
+            reaches(node, endComponent))
+            relax(node, goal, dtVdist(portal.position, end));
+    }
+
+    if (m_cost[goal] == (std::numeric_limits<float>::max)())
+        return false;
+
+    for (auto node = m_parent[goal]; node != source; node = m_parent[node])
+        route.push_back(node);
+
+    std::reverse(route.begin(), route.end());
+
+    return true;
+}
+} // namespace pathfind
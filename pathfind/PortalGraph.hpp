@@ -0,0 +1,82 @@
+#pragma once
+
+#include "Common.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <unordered_map>
+#include <vector>
+
+namespace pathfind
+{
+// abstract graph of the portals between clusters of tiles, used to plan long
+// paths before refining them with detour.  like Map, this type is not thread
+// safe.
+class PortalGraph
+{
+private:
+    std::vector<graphfiles::Node> m_nodes;
+
+    // outgoing edges of node n are m_edges[m_firstEdge[n]..m_firstEdge[n+1])
+    std::vector<std::uint32_t> m_firstEdge;
+    std::vector<graphfiles::Edge> m_edges;
+
+    std::unordered_map<std::uint32_t, std::vector<std::uint32_t>>
+        m_clusterNodes;
+
+    // component id of the polygons on either side of each portal, as built
+    std::vector<std::uint32_t> m_nodeComponents;
+
+    // connected component id of every polygon, per tile, as built
+    std::unordered_map<std::uint64_t, std::vector<std::uint32_t>> m_components;
+
+    // union-find forest over the component ids.  components are merged when
+    // temporary obstacles may have connected them
+    mutable std::vector<std::uint32_t> m_componentParent;
+
+    static std::uint64_t TileKey(int tileX, int tileY)
+    {
+        return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(tileX))
+                << 32) |
+               static_cast<std::uint32_t>(tileY);
+    }
+
+    std::uint32_t FindComponent(std::uint32_t component) const;
+
+    // search scratch, sized for every node plus the start and goal
+    mutable std::vector<float> m_cost;
+    mutable std::vector<std::uint32_t> m_parent;
+
+public:
+    // returns false when the graph does not exist, which is the case for data
+    // built by older versions
+    bool Load(const std::filesystem::path& path);
+
+    bool Empty() const { return m_nodes.empty(); }
+
+    const graphfiles::Node& GetNode(std::uint32_t node) const
+    {
+        return m_nodes[node];
+    }
+
+    bool HasComponents() const { return !m_componentParent.empty(); }
+
+    // returns the (possibly merged) component of the given polygon of the tile
+    // as it was built, or graphfiles::NoComponent when it is unknown
+    std::uint32_t GetComponent(int tileX, int tileY, std::uint32_t poly) const;
+
+    // called when the given tile has been rebuilt.  since any new polygons
+    // may connect to anything in or next to the tile, all components present
+    // in this neighborhood are merged
+    void MergeComponents(int tileX, int tileY);
+
+    // finds the cheapest sequence of portals leading from the start position
+    // in startCluster to the end position in endCluster.  the route begins
+    // and ends only at portals in the same component as the start and end
+    // polygons, unless that component is graphfiles::NoComponent
+    bool FindRoute(const float* start, std::uint32_t startCluster,
+                   std::uint32_t startComponent, const float* end,
+                   std::uint32_t endCluster, std::uint32_t endComponent,
+                   std::vector<std::uint32_t>& route) const;
+};
+} // namespace pathfind
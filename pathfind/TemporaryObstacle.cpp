@@ -10,10 +10,12 @@
 
 #include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cstdint>
 #include <iomanip>
 #include <sstream>
-#include <thread>
+#include <unordered_set>
+#include <vector>
 
 namespace
 {
@@ -238,8 +240,8 @@ void Map::AddGameObject(std::uint64_t guid, unsigned int displayId,
     auto const matrix =
         math::Matrix::CreateTranslationMatrix(position) * rotation;
 
-    auto const bvh_path = m_bvhLoader.GetBVHPath(displayId);
-    // TODO: Add logic based on bvh_path
+    auto const modelId = m_bvhLoader->GetModelId(displayId);
+    // TODO: Add logic based on the model kind
     auto const doodad = true;
     // auto const doodad = m_temporaryObstaclePaths[displayId][0] == 'd' ||
     // m_temporaryObstaclePaths[displayId][0] == 'D';
@@ -250,8 +252,8 @@ void Map::AddGameObject(std::uint64_t guid, unsigned int displayId,
 
         instance->m_transformMatrix = matrix;
         instance->m_inverseTransformMatrix = matrix.ComputeInverse();
-        instance->m_modelFilename = bvh_path;
-        auto model = EnsureDoodadModelLoaded(bvh_path);
+        instance->m_modelId = modelId;
+        auto model = EnsureDoodadModelLoaded(modelId);
         instance->m_model = model;
 
         instance->m_translatedVertices.reserve(
@@ -271,13 +273,8 @@ void Map::AddGameObject(std::uint64_t guid, unsigned int displayId,
         instance->m_bounds = bounds;
         m_temporaryDoodads[guid] = instance;
 
-        for (auto const& tile : m_tiles)
-        {
-            if (!tile.second->m_bounds.intersect2d(instance->m_bounds))
-                continue;
-
-            tile.second->AddTemporaryDoodad(guid, instance);
-        }
+        // the tiles are updated by UpdateObstacles
+        m_pendingObstacles.push_back({guid, std::move(instance)});
     }
     else
     {
@@ -298,22 +295,187 @@ void Map::AddGameObject(std::uint64_t guid, unsigned int displayId,
     }
 }
 
+bool Map::RemoveGameObject(std::uint64_t guid)
+{
+    auto const doodad = m_temporaryDoodads.find(guid);
+    auto const wmo = m_temporaryWmos.find(guid);
+
+    if (doodad == m_temporaryDoodads.end() && wmo == m_temporaryWmos.end())
+        return false;
+
+    if (doodad != m_temporaryDoodads.end())
+        m_temporaryDoodads.erase(doodad);
+    if (wmo != m_temporaryWmos.end())
+        m_temporaryWmos.erase(wmo);
+
+    // the obstacle may not have been applied yet
+    m_pendingObstacles.erase(
+        std::remove_if(m_pendingObstacles.begin(), m_pendingObstacles.end(),
+                       [guid](const PendingObstacle& pending) {
+                           return pending.guid == guid;
+                       }),
+        m_pendingObstacles.end());
+
+    std::vector<std::pair<int, int>> tiles;
+
+    for (auto const& tile : m_tiles)
+    {
+        // wmos are never rasterized, so only their reference is dropped
+        tile.second->m_temporaryWmos.erase(guid);
+
+        if (tile.second->RemoveTemporaryDoodad(guid))
+            tiles.push_back(tile.first);
+    }
+
+    if (!tiles.empty())
+        m_dirtyTileGroups.push_back(std::move(tiles));
+
+    return true;
+}
+
+ObstacleUpdateStatistics Map::UpdateObstacles(int maxTiles)
+{
+    auto const start = std::chrono::steady_clock::now();
+
+    for (auto& pending : m_pendingObstacles)
+    {
+        std::vector<std::pair<int, int>> tiles;
+
+        for (auto const& tile : m_tiles)
+        {
+            if (!tile.second->m_bounds.intersect2d(pending.doodad->m_bounds))
+                continue;
+
+            tile.second->AddTemporaryDoodad(pending.guid, pending.doodad);
+            tiles.push_back(tile.first);
+        }
+
+        if (!tiles.empty())
+            m_dirtyTileGroups.push_back(std::move(tiles));
+    }
+
+    m_pendingObstacles.clear();
+
+    // an obstacle must appear in all of its tiles at once, so groups which
+    // share a tile are always rebuilt together
+    std::unordered_set<std::pair<int, int>> selected;
+    std::vector<Tile*> batch;
+
+    auto const take = [&](const std::vector<std::pair<int, int>>& group) {
+        for (auto const& coords : group)
+        {
+            if (!selected.insert(coords).second)
+                continue;
+
+            auto const tile = m_tiles.find(coords);
+
+            // the tile may have been unloaded since it was changed
+            if (tile != m_tiles.end() && tile->second->m_meshDirty)
+                batch.push_back(tile->second.get());
+        }
+    };
+
+    while (!m_dirtyTileGroups.empty() &&
+           (maxTiles < 0 || static_cast<int>(batch.size()) < maxTiles))
+    {
+        take(m_dirtyTileGroups.front());
+        m_dirtyTileGroups.pop_front();
+
+        for (auto found = true; found;)
+        {
+            found = false;
+
+            for (auto i = m_dirtyTileGroups.begin();
+                 i != m_dirtyTileGroups.end();)
+            {
+                auto const shared = std::any_of(
+                    i->cbegin(), i->cend(), [&](const std::pair<int, int>& c) {
+                        return selected.find(c) != selected.end();
+                    });
+
+                if (!shared)
+                {
+                    ++i;
+                    continue;
+                }
+
+                take(*i);
+                i = m_dirtyTileGroups.erase(i);
+                found = true;
+            }
+        }
+    }
+
+    // the meshes are built concurrently, since tiles share no state while
+    // doing so.  swapping them into the navmesh is left to this thread
+    std::vector<std::vector<std::uint8_t>> meshes(batch.size());
+    std::vector<char> bases(batch.size());
+
+    m_obstacleWorkers.Run(batch.size(), [&](size_t i) {
+        bases[i] = batch[i]->BuildMesh(meshes[i]);
+    });
+
+    for (auto i = 0u; i < batch.size(); ++i)
+        batch[i]->SwapMesh(std::move(meshes[i]), !!bases[i]);
+
+    std::unordered_set<std::pair<int, int>> pending;
+    for (auto const& group : m_dirtyTileGroups)
+        pending.insert(group.cbegin(), group.cend());
+
+    ObstacleUpdateStatistics result;
+    result.tilesRebuilt = static_cast<int>(batch.size());
+    result.tilesPending = static_cast<int>(pending.size());
+    result.milliseconds = std::chrono::duration<float, std::milli>(
+                              std::chrono::steady_clock::now() - start)
+                              .count();
+
+    return result;
+}
+
+void Map::SetObstacleThreads(std::size_t threads)
+{
+    m_obstacleWorkers.SetThreads(threads);
+}
+
 void Tile::AddTemporaryDoodad(std::uint64_t guid,
                               std::shared_ptr<DoodadInstance> doodad)
 {
     if (!m_heightField.spans)
         LoadHeightField();
 
-    auto const model = doodad->m_model.lock();
+    RasterizeTemporaryDoodad(*doodad);
+
+    m_temporaryDoodads[guid] = std::move(doodad);
+    m_meshDirty = true;
+}
+
+bool Tile::RemoveTemporaryDoodad(std::uint64_t guid)
+{
+    if (!m_temporaryDoodads.erase(guid))
+        return false;
+
+    // rasterization cannot be undone, so start over from the height field as
+    // it was built
+    RestoreHeightField();
+
+    for (auto const& doodad : m_temporaryDoodads)
+        RasterizeTemporaryDoodad(*doodad.second);
+
+    m_meshDirty = true;
+
+    return true;
+}
+
+void Tile::RasterizeTemporaryDoodad(const DoodadInstance& doodad)
+{
+    auto const model = doodad.m_model.lock();
 
     std::vector<float> recastVertices;
-    math::Convert::VerticesToRecast(doodad->m_translatedVertices,
+    math::Convert::VerticesToRecast(doodad.m_translatedVertices,
                                     recastVertices);
 
     std::vector<unsigned char> areas(model->m_aabbTree.Indices().size());
 
-    m_temporaryDoodads[guid] = std::move(doodad);
-
     RecastContext ctx(rcLogCategory::RC_LOG_ERROR);
     rcClearUnwalkableTriangles(
         &ctx, MeshSettings::WalkableSlope, &recastVertices[0],
@@ -325,6 +487,18 @@ void Tile::AddTemporaryDoodad(std::uint64_t guid,
         &model->m_aabbTree.Indices()[0], &areas[0],
         static_cast<int>(model->m_aabbTree.Indices().size() / 3),
         m_heightField);
+}
+
+bool Tile::BuildMesh(std::vector<std::uint8_t>& out)
+{
+    // with no obstacles left, the mesh is exactly as it was built
+    if (m_temporaryDoodads.empty())
+    {
+        out = m_baseTileSaved ? m_baseTileData : m_tileData;
+        return true;
+    }
+
+    RecastContext ctx(rcLogCategory::RC_LOG_ERROR);
 
     // we don't want to filter ledge spans from ADT terrain.  this will restore
     // the area for these spans, which we are using for flags
@@ -357,11 +531,27 @@ void Tile::AddTemporaryDoodad(std::uint64_t guid,
 
     // build the mesh into a secondary buffer, rather than overwriting the
     // previous tile, so that we can delay the old tile's removal
-    std::vector<std::uint8_t> newTileData;
+    out.clear();
     auto const buildResult =
-        RebuildMeshTile(ctx, config, m_x, m_y, m_heightField, newTileData);
+        RebuildMeshTile(ctx, config, m_x, m_y, m_heightField, out);
     assert(buildResult);
 
+    return false;
+}
+
+void Tile::SwapMesh(std::vector<std::uint8_t>&& data, bool base)
+{
+    m_meshDirty = false;
+
+    ReplaceMesh(std::move(data), base);
+
+    // the new mesh may join islands which were separate when built
+    if (!m_temporaryDoodads.empty())
+        m_map->m_portalGraph.MergeComponents(m_x, m_y);
+}
+
+void Tile::ReplaceMesh(std::vector<std::uint8_t>&& data, bool base)
+{
     if (m_ref)
     {
         auto const removeResult =
@@ -369,11 +559,28 @@ void Tile::AddTemporaryDoodad(std::uint64_t guid,
         assert(removeResult == DT_SUCCESS);
     }
 
-    m_tileData = std::move(newTileData);
+    if (!m_baseTileSaved)
+    {
+        m_baseTileData = std::move(m_tileData);
+        m_baseTileSaved = true;
+    }
+
+    m_tileData = std::move(data);
+    m_baseMesh = base;
+
+    // the rebuilt tile may have no navigable geometry at all
+    if (m_tileData.empty())
+        m_ref = 0;
+    else
+    {
+        auto const insertResult = m_map->m_navMesh.addTile(
+            &m_tileData[0], static_cast<int>(m_tileData.size()), 0, m_ref,
+            &m_ref);
 
-    auto const insertResult = m_map->m_navMesh.addTile(
-        &m_tileData[0], static_cast<int>(m_tileData.size()), 0, m_ref, &m_ref);
+        assert(insertResult == DT_SUCCESS);
+    }
 
-    assert(insertResult == DT_SUCCESS);
+    // invalidates any cached paths through this tile
+    m_version = ++m_map->m_tileVersion;
 }
 } // namespace pathfind
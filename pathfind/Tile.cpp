@@ -18,7 +18,9 @@ namespace pathfind
 {
 Tile::Tile(Map* map, utility::BinaryStream& in, const fs::path& navPath,
            bool load_heightfield)
-    : m_map(map), m_navPath(navPath), m_ref(0), m_x(in.Read<std::uint32_t>()),
+    : m_map(map), m_navPath(navPath), m_baseTileSaved(false),
+      m_spanBlock(nullptr), m_meshDirty(false), m_baseMesh(true), m_ref(0),
+      m_version(++map->m_tileVersion), m_x(in.Read<std::uint32_t>()),
       m_y(in.Read<std::uint32_t>()), m_areaId(0)
 {
     std::uint32_t wmoCount;
@@ -95,13 +97,10 @@ Tile::Tile(Map* map, utility::BinaryStream& in, const fs::path& navPath,
     {
         m_heightField.spans = nullptr;
 
-        for (auto i = 0; i < m_heightField.width * m_heightField.height; ++i)
-        {
-            std::uint32_t columnSize;
-            in >> columnSize;
+        std::uint32_t spansSize;
+        in >> spansSize;
 
-            in.rpos(in.rpos() + 3 * columnSize * sizeof(std::uint32_t));
-        }
+        in.rpos(in.rpos() + spansSize);
     }
 
     // read mesh
@@ -128,13 +127,18 @@ Tile::~Tile()
         assert(result == DT_SUCCESS);
     }
 
-    if (!!m_heightField.spans)
-        for (auto i = 0; i < m_heightField.width * m_heightField.height; ++i)
-            rcFree(m_heightField.spans[i]);
+    // the column array and span pools belong to the height field
+    rcFree(m_spanBlock);
 }
 
 void Tile::LoadHeightField()
 {
+    if (!m_baseColumns.empty())
+    {
+        RestoreHeightField();
+        return;
+    }
+
     utility::BinaryStream in(m_navPath);
     in.rpos(m_heightFieldSpanStart);
     LoadHeightField(in);
@@ -144,36 +148,118 @@ void Tile::LoadHeightField(utility::BinaryStream& in)
 {
     assert(!m_heightField.spans);
 
-    m_heightField.spans = reinterpret_cast<rcSpan**>(
-        rcAlloc(m_heightField.width * m_heightField.height * sizeof(rcSpan*),
-                RC_ALLOC_PERM));
+    // see SerializeHeightField in MeshBuilder.cpp for the encoding
+    std::uint32_t spansSize;
+    in >> spansSize;
+
+    std::vector<std::uint8_t> spans(spansSize);
+    if (spansSize)
+        in.ReadBytes(&spans[0], spans.size());
+
+    size_t position = 0;
+    auto const readVarInt = [&spans, &position]() {
+        std::uint32_t result = 0;
+
+        for (auto shift = 0; position < spans.size(); shift += 7)
+        {
+            auto const byte = spans[position++];
+            result |= static_cast<std::uint32_t>(byte & 0x7F) << shift;
+
+            if (!(byte & 0x80))
+                break;
+        }
+
+        return result;
+    };
+
+    auto const columns = m_heightField.width * m_heightField.height;
+
+    m_baseColumns.resize(columns + 1);
+    m_baseSpans.clear();
 
-    for (auto i = 0; i < m_heightField.width * m_heightField.height; ++i)
+    for (auto i = 0; i < columns;)
     {
-        std::uint32_t columnSize;
-        in >> columnSize;
+        auto const count = readVarInt();
 
-        if (!columnSize)
+        if (!count)
         {
-            m_heightField.spans[i] = nullptr;
+            auto const run = 1 + static_cast<int>(readVarInt());
+            assert(i + run <= columns);
+
+            for (auto r = 0; r < run; ++r)
+                m_baseColumns[i + r] =
+                    static_cast<std::uint32_t>(m_baseSpans.size());
+
+            i += run;
             continue;
         }
 
-        m_heightField.spans[i] = reinterpret_cast<rcSpan*>(
-            rcAlloc(columnSize * sizeof(rcSpan), RC_ALLOC_PERM));
+        m_baseColumns[i] = static_cast<std::uint32_t>(m_baseSpans.size());
 
-        for (auto s = 0u; s < columnSize; ++s)
+        std::uint32_t previous = 0;
+        for (auto s = 0u; s < count; ++s)
         {
-            std::uint32_t smin, smax, area;
-            in >> smin >> smax >> area;
+            auto const smin = previous + readVarInt();
+            auto const heightAndArea = readVarInt();
+            auto const smax = smin + (heightAndArea >> 6);
+
+            m_baseSpans.push_back(smin | (smax << RC_SPAN_HEIGHT_BITS) |
+                                  ((heightAndArea & 0x3F)
+                                   << (2 * RC_SPAN_HEIGHT_BITS)));
+            previous = smax;
+        }
+
+        ++i;
+    }
+
+    assert(position == spans.size());
+
+    m_baseColumns.back() = static_cast<std::uint32_t>(m_baseSpans.size());
+
+    RestoreHeightField();
+}
+
+void Tile::RestoreHeightField()
+{
+    auto const columns = m_heightField.width * m_heightField.height;
+
+    if (!m_heightField.spans)
+        m_heightField.spans = reinterpret_cast<rcSpan**>(
+            rcAlloc(columns * sizeof(rcSpan*), RC_ALLOC_PERM));
+
+    // discard any spans added by rasterization
+    while (m_heightField.pools)
+    {
+        auto const next = m_heightField.pools->next;
+        rcFree(m_heightField.pools);
+        m_heightField.pools = next;
+    }
+
+    m_heightField.freelist = nullptr;
+
+    rcFree(m_spanBlock);
+    m_spanBlock = m_baseSpans.empty()
+                      ? nullptr
+                      : reinterpret_cast<rcSpan*>(rcAlloc(
+                            m_baseSpans.size() * sizeof(rcSpan), RC_ALLOC_PERM));
+
+    constexpr std::uint32_t heightMask = (1u << RC_SPAN_HEIGHT_BITS) - 1;
 
-            m_heightField.spans[i][s].smin = smin;
-            m_heightField.spans[i][s].smax = smax;
-            m_heightField.spans[i][s].area = area;
-            m_heightField.spans[i][s].next = nullptr;
+    for (auto i = 0; i < columns; ++i)
+    {
+        auto const begin = m_baseColumns[i];
+        auto const end = m_baseColumns[i + 1];
+
+        m_heightField.spans[i] = begin == end ? nullptr : &m_spanBlock[begin];
+
+        for (auto s = begin; s < end; ++s)
+        {
+            auto const packed = m_baseSpans[s];
 
-            if (s > 0)
-                m_heightField.spans[i][s - 1].next = &m_heightField.spans[i][s];
+            m_spanBlock[s].smin = packed & heightMask;
+            m_spanBlock[s].smax = (packed >> RC_SPAN_HEIGHT_BITS) & heightMask;
+            m_spanBlock[s].area = packed >> (2 * RC_SPAN_HEIGHT_BITS);
+            m_spanBlock[s].next = s + 1 < end ? &m_spanBlock[s + 1] : nullptr;
         }
     }
 }
@@ -28,12 +28,35 @@ private:
 
     std::vector<std::uint8_t> m_tileData;
 
+    // the mesh as it was built, saved when the tile is first rebuilt so that
+    // it can be restored once every temporary obstacle is removed
+    std::vector<std::uint8_t> m_baseTileData;
+    bool m_baseTileSaved;
+
     // store this for possible delayed load of the data
     size_t m_heightFieldSpanStart;
     rcHeightfield m_heightField;
 
+    // the height field as it was built, from which it is restored when
+    // temporary obstacles are removed.  each span is packed into 32 bits as
+    // smin | smax << 13 | area << 26, and column i holds the spans
+    // m_baseSpans[m_baseColumns[i]] up to m_baseSpans[m_baseColumns[i + 1]]
+    std::vector<std::uint32_t> m_baseColumns;
+    std::vector<std::uint32_t> m_baseSpans;
+
+    // the restored spans share this one allocation.  spans added by
+    // rasterization come from the height field's own pools
+    rcSpan* m_spanBlock;
+
     void LoadHeightField(utility::BinaryStream& in);
     void LoadHeightField();
+    void RestoreHeightField();
+
+    void RasterizeTemporaryDoodad(const DoodadInstance& doodad);
+
+    // swaps the tile's mesh in the navmesh for the given data.  base says
+    // whether it is the mesh as it was built
+    void ReplaceMesh(std::vector<std::uint8_t>&& data, bool base);
 
 public:
     // the height field should only be loaded for tiles that will have temporary
@@ -42,11 +65,36 @@ public:
          bool load_heightfield = false);
     ~Tile();
 
+    // rasterizes the doodad into the height field, leaving the tile's mesh
+    // dirty
     void AddTemporaryDoodad(std::uint64_t guid,
                             std::shared_ptr<DoodadInstance> doodad);
 
+    // restores the height field and rasterizes the remaining doodads into it,
+    // leaving the tile's mesh dirty.  returns false if the doodad was not
+    // present in this tile
+    bool RemoveTemporaryDoodad(std::uint64_t guid);
+
+    // builds a new mesh from the height field.  this touches nothing outside
+    // of the tile, so distinct tiles may be built concurrently.  returns true
+    // if the mesh is the one originally built, as no obstacles remain
+    bool BuildMesh(std::vector<std::uint8_t>& out);
+
+    // replaces the tile's mesh in the navmesh with one from BuildMesh
+    void SwapMesh(std::vector<std::uint8_t>&& data, bool base);
+
+    bool m_meshDirty;
+
+    // true while the mesh in the navmesh is the one originally built.  this
+    // stays false after the last obstacle is removed until the original mesh
+    // is swapped back in
+    bool m_baseMesh;
+
     dtTileRef m_ref;
 
+    // changes whenever the tile's mesh is rebuilt
+    std::uint32_t m_version;
+
     math::BoundingBox m_bounds;
 
     const int m_x;
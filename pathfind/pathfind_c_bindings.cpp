@@ -212,26 +212,21 @@ PathfindResultType pathfind_find_path(pathfind::Map* const map,
     const math::Vertex start {start_x, start_y, start_z};
     const math::Vertex stop {stop_x, stop_y, stop_z};
 
-    std::vector<math::Vertex> path;
+    static_assert(sizeof(Vertex) == sizeof(math::Vertex),
+                  "C Vertex must be layout compatible with math::Vertex");
 
     try {
-        if (map->FindPath(start, stop, path)) {
-            if (path.size() > buffer_length) {
-                *amount_of_vertices = static_cast<unsigned int>(path.size());
-                return static_cast<PathfindResultType>(Result::BUFFER_TOO_SMALL);
-            }
-
-            auto vbuf = static_cast<Vertex*>(static_cast<void*>(buffer));
+        std::size_t path_length;
 
-            for (int i = 0; i < path.size(); ++i) {
-                const auto point = path[i];
-                const auto v = Vertex { point.X, point.Y, point.Z};
-                vbuf[i] = v;
-            }
-
-            *amount_of_vertices = static_cast<unsigned int>(path.size());
+        // the path is written straight into the caller's buffer
+        if (map->FindPath(start, stop, reinterpret_cast<math::Vertex*>(buffer),
+                          buffer_length, path_length)) {
+            *amount_of_vertices = static_cast<unsigned int>(path_length);
 
             return static_cast<PathfindResultType>(Result::SUCCESS);
+        } else if (path_length > buffer_length) {
+            *amount_of_vertices = static_cast<unsigned int>(path_length);
+            return static_cast<PathfindResultType>(Result::BUFFER_TOO_SMALL);
         } else {
             return static_cast<PathfindResultType>(Result::UNKNOWN_PATH);
         }
@@ -244,6 +239,127 @@ PathfindResultType pathfind_find_path(pathfind::Map* const map,
     }
 }
 
+PathfindResultType pathfind_set_path_cache_capacity(pathfind::Map* const map,
+                                                    uint32_t capacity,
+                                                    float quantization)
+{
+    try {
+        map->SetPathCacheCapacity(capacity, quantization);
+
+        return static_cast<PathfindResultType>(Result::SUCCESS);
+    }
+    catch (utility::exception& e) {
+        return static_cast<PathfindResultType>(e.ResultCode());
+    }
+    catch (...) {
+        return static_cast<PathfindResultType>(Result::UNKNOWN_EXCEPTION);
+    }
+}
+
+PathfindResultType pathfind_get_path_cache_statistics(pathfind::Map* const map,
+                                                      uint64_t* const hits,
+                                                      uint64_t* const misses,
+                                                      uint64_t* const invalidations)
+{
+    auto const& cache = map->GetPathCache();
+
+    *hits = cache.Hits();
+    *misses = cache.Misses();
+    *invalidations = cache.Invalidations();
+
+    return static_cast<PathfindResultType>(Result::SUCCESS);
+}
+
+PathfindResultType pathfind_submit_path(pathfind::Map* const map,
+                                        float start_x,
+                                        float start_y,
+                                        float start_z,
+                                        float stop_x,
+                                        float stop_y,
+                                        float stop_z,
+                                        uint32_t* const request)
+{
+    try {
+        *request = map->SubmitPath({start_x, start_y, start_z},
+                                   {stop_x, stop_y, stop_z});
+
+        return static_cast<PathfindResultType>(Result::SUCCESS);
+    }
+    catch (utility::exception& e) {
+        return static_cast<PathfindResultType>(e.ResultCode());
+    }
+    catch (...) {
+        return static_cast<PathfindResultType>(Result::UNKNOWN_EXCEPTION);
+    }
+}
+
+PathfindResultType pathfind_update_paths(pathfind::Map* const map,
+                                         int32_t max_iterations,
+                                         int32_t* const iterations_done)
+{
+    try {
+        *iterations_done = map->UpdatePaths(max_iterations);
+
+        return static_cast<PathfindResultType>(Result::SUCCESS);
+    }
+    catch (utility::exception& e) {
+        return static_cast<PathfindResultType>(e.ResultCode());
+    }
+    catch (...) {
+        return static_cast<PathfindResultType>(Result::UNKNOWN_EXCEPTION);
+    }
+}
+
+PathfindResultType pathfind_poll_path(pathfind::Map* const map,
+                                      uint32_t request,
+                                      Vertex* const buffer,
+                                      unsigned int buffer_length,
+                                      unsigned int* const amount_of_vertices)
+{
+    try {
+        std::size_t path_length;
+
+        switch (map->TakePath(request, reinterpret_cast<math::Vertex*>(buffer),
+                              buffer_length, path_length)) {
+            case pathfind::PathRequestStatus::InProgress:
+                return static_cast<PathfindResultType>(Result::PATH_REQUEST_IN_PROGRESS);
+            case pathfind::PathRequestStatus::Failed:
+                return static_cast<PathfindResultType>(Result::UNKNOWN_PATH);
+            case pathfind::PathRequestStatus::Succeeded:
+                *amount_of_vertices = static_cast<unsigned int>(path_length);
+
+                if (path_length > buffer_length)
+                    return static_cast<PathfindResultType>(Result::BUFFER_TOO_SMALL);
+
+                return static_cast<PathfindResultType>(Result::SUCCESS);
+            default:
+                return static_cast<PathfindResultType>(Result::UNKNOWN_PATH_REQUEST);
+        }
+    }
+    catch (utility::exception& e) {
+        return static_cast<PathfindResultType>(e.ResultCode());
+    }
+    catch (...) {
+        return static_cast<PathfindResultType>(Result::UNKNOWN_EXCEPTION);
+    }
+}
+
+PathfindResultType pathfind_cancel_path(pathfind::Map* const map,
+                                        uint32_t request)
+{
+    try {
+        map->CancelPath(request);
+
+        return static_cast<PathfindResultType>(Result::SUCCESS);
+    }
+    catch (utility::exception& e) {
+        return static_cast<PathfindResultType>(e.ResultCode());
+    }
+    catch (...) {
+        return static_cast<PathfindResultType>(Result::UNKNOWN_EXCEPTION);
+    }
+}
+
 PathfindResultType pathfind_find_heights(pathfind::Map* const map,
                   float x,
                   float y,
@@ -329,6 +445,30 @@ PathfindResultType pathfind_line_of_sight(pathfind::Map* map,
     }
 }
 
+PathfindResultType pathfind_are_connected(pathfind::Map* const map,
+                                          float start_x, float start_y, float start_z,
+                                          float end_x, float end_y, float end_z,
+                                          uint8_t* const connected) {
+    try
+    {
+        if (map->AreConnected({start_x, start_y, start_z}, {end_x, end_y, end_z})) {
+            *connected = 1;
+        } else {
+            *connected = 0;
+        }
+
+        return static_cast<PathfindResultType>(Result::SUCCESS);
+    }
+    catch (utility::exception& e)
+    {
+        return static_cast<PathfindResultType>(e.ResultCode());
+    }
+    catch (...)
+    {
+        return static_cast<PathfindResultType>(Result::UNKNOWN_EXCEPTION);
+    }
+}
+
 PathfindResultType pathfind_find_random_point_around_circle(pathfind::Map* const map,
                                                             float x,
                                                             float y,
@@ -89,6 +89,10 @@ PathfindResultType pathfind_find_point_in_between_vectors(pathfind::Map* const m
 /*
     Calculates a path from `start_x`, `start_y`, and `start_z` to
     `stop_x`, `stop_y`, and `stop_z`.
+
+    The path is written directly into `buffer`.  If `buffer_length` is too
+    small, `BUFFER_TOO_SMALL` is returned and `amount_of_vertices` is set to
+    the required length.
 */
 PathfindResultType pathfind_find_path(pathfind::Map* const map, float start_x,
                                       float start_y, float start_z,
@@ -97,6 +101,67 @@ PathfindResultType pathfind_find_path(pathfind::Map* const map, float start_x,
                                       unsigned int buffer_length,
                                       unsigned int* const amount_of_vertices);
 
+/*
+    Enables a cache of up to `capacity` paths in front of `pathfind_find_path`.
+
+    Paths whose endpoints fall within the same `quantization` sized cell share
+    a result.  A capacity of `0` disables the cache.
+*/
+PathfindResultType pathfind_set_path_cache_capacity(pathfind::Map* const map,
+                                                    uint32_t capacity,
+                                                    float quantization);
+
+/*
+    Returns the number of path cache hits, misses and invalidations.
+*/
+PathfindResultType pathfind_get_path_cache_statistics(pathfind::Map* const map,
+                                                      uint64_t* const hits,
+                                                      uint64_t* const misses,
+                                                      uint64_t* const invalidations);
+
+/*
+    Queues a path from `start_x`, `start_y`, and `start_z` to
+    `stop_x`, `stop_y`, and `stop_z` to be calculated over several calls to
+    `pathfind_update_paths`.
+
+    The handle written to `request` is used to poll for the result.
+*/
+PathfindResultType pathfind_submit_path(pathfind::Map* const map, float start_x,
+                                        float start_y, float start_z,
+                                        float stop_x, float stop_y, float stop_z,
+                                        uint32_t* const request);
+
+/*
+    Advances queued paths, spending at most `max_iterations` node expansions
+    across all of them.
+
+    The amount of iterations actually used is written to `iterations_done`.
+*/
+PathfindResultType pathfind_update_paths(pathfind::Map* const map,
+                                         int32_t max_iterations,
+                                         int32_t* const iterations_done);
+
+/*
+    Retrieves the path of a queued request.
+
+    Returns `PATH_REQUEST_IN_PROGRESS` until the request has finished and
+    `UNKNOWN_PATH` if no path was found.  If `buffer_length` is too small,
+    `BUFFER_TOO_SMALL` is returned, `amount_of_vertices` is set to the
+    required length and the request can be polled again.  Otherwise the
+    request is released.
+*/
+PathfindResultType pathfind_poll_path(pathfind::Map* const map,
+                                      uint32_t request,
+                                      Vertex* const buffer,
+                                      unsigned int buffer_length,
+                                      unsigned int* const amount_of_vertices);
+
+/*
+    Discards a queued request, whether or not it has finished.
+*/
+PathfindResultType pathfind_cancel_path(pathfind::Map* const map,
+                                        uint32_t request);
+
 /*
     Slices the map at `x`, `y` and returns all possible `z` values.
 */
@@ -126,6 +191,19 @@ PathfindResultType pathfind_line_of_sight(pathfind::Map* const map,
                                           float stop_x, float stop_y, float stop_z,
                                           uint8_t* const line_of_sight, uint8_t doodads);
 
+/*
+    Calculates whether a path between `start_x`, `start_y`, `start_z` and
+    `end_x`, `end_y`, `end_z` may exist.
+
+    `connected` is set to `0` only when the positions are on separate islands
+    of the navigation mesh, which is much cheaper to determine than a failed
+    `pathfind_find_path`.
+*/
+PathfindResultType pathfind_are_connected(pathfind::Map* const map,
+                                          float start_x, float start_y, float start_z,
+                                          float end_x, float end_y, float end_z,
+                                          uint8_t* const connected);
+
 /*
     Returns a random point within `radius` of `x`, `y`, and `z`.
 */
@@ -32,6 +32,57 @@ py::list python_find_path(const pathfind::Map& map, float start_x,
     return result;
 }
 
+std::uint32_t python_submit_path(pathfind::Map& map, float start_x,
+                                 float start_y, float start_z, float stop_x,
+                                 float stop_y, float stop_z)
+{
+    return map.SubmitPath({start_x, start_y, start_z}, {stop_x, stop_y, stop_z});
+}
+
+py::object python_poll_path(pathfind::Map& map, std::uint32_t request)
+{
+    std::vector<math::Vertex> path;
+
+    switch (map.TakePath(request, path))
+    {
+        case pathfind::PathRequestStatus::InProgress:
+            return py::none();
+        case pathfind::PathRequestStatus::Unknown:
+            throw std::runtime_error("Unknown path request");
+        default:
+            break;
+    }
+
+    py::list result;
+
+    for (auto const& point : path)
+        result.append(py::make_tuple(point.X, point.Y, point.Z));
+
+    return result;
+}
+
+py::tuple path_cache_statistics(const pathfind::Map& map)
+{
+    auto const& cache = map.GetPathCache();
+
+    return py::make_tuple(cache.Hits(), cache.Misses(), cache.Invalidations());
+}
+
+void add_game_object(pathfind::Map& map, std::uint64_t guid,
+                     unsigned int display_id, float x, float y, float z,
+                     float orientation, int doodad_set)
+{
+    map.AddGameObject(guid, display_id, {x, y, z}, orientation, doodad_set);
+}
+
+py::tuple update_obstacles(pathfind::Map& map, int max_tiles)
+{
+    auto const stats = map.UpdateObstacles(max_tiles);
+
+    return py::make_tuple(stats.tilesRebuilt, stats.tilesPending,
+                          stats.milliseconds);
+}
+
 py::tuple load_adt(pathfind::Map& map, int adt_x, int adt_y)
 {
     if (!map.HasADT(adt_x, adt_y))
@@ -101,6 +152,12 @@ bool los(const pathfind::Map& map, float start_x, float start_y, float start_z,
             doodads);
 }
 
+bool are_connected(const pathfind::Map& map, float start_x, float start_y,
+                   float start_z, float end_x, float end_y, float end_z)
+{
+    return map.AreConnected({start_x, start_y, start_z}, {end_x, end_y, end_z});
+}
+
 py::object get_zone_and_area(pathfind::Map& map, float x, float y, float z)
 {
     math::Vertex p {x, y, z};
@@ -173,6 +230,85 @@ Returns a list of points if a path was found, otherwise an empty list.)del",
            py::arg("stop_y"),
            py::arg("stop_z")
         )
+        .def("set_path_cache_capacity",
+            &pathfind::Map::SetPathCacheCapacity,
+            R"del(Enables a cache of up to `capacity` paths in front of `find_path`.
+
+Paths whose endpoints fall within the same `quantization` sized cell share a result.  A capacity of 0 disables the cache.)del",
+            py::arg("capacity"),
+            py::arg("quantization") = 0.5f
+        )
+        .def("path_cache_statistics",
+            &path_cache_statistics,
+            "Returns the number of path cache hits, misses and invalidations as a tuple."
+        )
+        .def("hierarchical_path_count",
+            &pathfind::Map::HierarchicalPaths,
+            "Returns the number of paths `find_path` has planned over the portal graph between distant clusters."
+        )
+        .def("add_game_object",
+            &add_game_object,
+            R"del(Adds a temporary obstacle using the model of game object display ID `display_id`, rotated `orientation` radians around the Z axis.
+
+Paths do not reflect it until the tiles it touches are rebuilt by `update_obstacles`.)del",
+            py::arg("guid"),
+            py::arg("display_id"),
+            py::arg("x"),
+            py::arg("y"),
+            py::arg("z"),
+            py::arg("orientation"),
+            py::arg("doodad_set") = -1
+        )
+        .def("remove_game_object",
+            &pathfind::Map::RemoveGameObject,
+            R"del(Removes a temporary obstacle added by `add_game_object`.
+
+Returns `False` if there is no game object with the given `guid`.)del",
+            py::arg("guid")
+        )
+        .def("update_obstacles",
+            &update_obstacles,
+            R"del(Rebuilds about `max_tiles` of the tiles affected by added or removed game objects.  A negative budget rebuilds every affected tile.
+
+Returns the number of tiles rebuilt, the number still pending and the milliseconds spent as a tuple.)del",
+            py::arg("max_tiles")
+        )
+        .def("set_obstacle_threads",
+            &pathfind::Map::SetObstacleThreads,
+            "Sets the number of threads on which `update_obstacles` rebuilds tiles.  Zero uses one per core.",
+            py::arg("threads")
+        )
+        .def("submit_path",
+            &python_submit_path,
+            R"del(Queues a path between `start` and `stop` to be calculated by `update_paths`.
+
+Returns a handle which is passed to `poll_path`.)del",
+            py::arg("start_x"),
+            py::arg("start_y"),
+            py::arg("start_z"),
+            py::arg("stop_x"),
+            py::arg("stop_y"),
+            py::arg("stop_z")
+        )
+        .def("update_paths",
+            &pathfind::Map::UpdatePaths,
+            R"del(Advances queued paths, spending at most `max_iterations` node expansions across all of them.
+
+Returns the amount of iterations used.)del",
+            py::arg("max_iterations")
+        )
+        .def("poll_path",
+            &python_poll_path,
+            R"del(Retrieves the result of a queued path.
+
+Returns `None` while the path is still being calculated.  Otherwise the request is released and a list of points is returned, which is empty if no path was found.)del",
+            py::arg("request")
+        )
+        .def("cancel_path",
+            &pathfind::Map::CancelPath,
+            "Discards a queued path.",
+            py::arg("request")
+        )
         .def("query_heights",
             &python_query_heights,
             "Finds all Z values for a given `x`, `y` coordinate.",
@@ -244,5 +380,17 @@ If `doodads` is `False` doodads will not be considered during calculations.)del"
             py::arg("stop_y"),
             py::arg("stop_z"),
             py::arg("doodads")
+        )
+        .def("are_connected",
+            &are_connected,
+            R"del(Returns `False` when no path from `start` to `end` can exist.
+
+This is much cheaper than a failed `find_path`, but `True` does not guarantee that a path will be found.)del",
+            py::arg("start_x"),
+            py::arg("start_y"),
+            py::arg("start_z"),
+            py::arg("end_x"),
+            py::arg("end_y"),
+            py::arg("end_z")
         );
 }
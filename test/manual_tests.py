@@ -86,6 +86,73 @@ def test_use_data(nav_data):
 
     print('Deathknell doorway test succeeded')
 
+    # A game object placed on the path through the doorway should send it
+    # elsewhere, and removing it should restore the original path.  Display
+    # IDs vary between clients, so the first one found with a model which
+    # alters the path is used
+    start = (1942.09863, 1541.59216, 90.514)
+    stop = (1940.185, 1522.914, 88.229)
+
+    longest = max(range(1, len(path)), key=lambda i: math.dist(
+        path[i-1], path[i]))
+    obstacle = [(a + b) / 2 for a, b in zip(path[longest-1], path[longest])]
+
+    guid = 1
+    blocked_path = None
+    for display_id in range(1, 10000):
+        try:
+            azeroth.add_game_object(guid, display_id, *obstacle, 0)
+        except RuntimeError:
+            continue
+
+        _, pending, _ = azeroth.update_obstacles(-1)
+        assert pending == 0
+
+        blocked_path = azeroth.find_path(*start, *stop)
+        if blocked_path != path:
+            break
+
+        assert azeroth.remove_game_object(guid)
+        azeroth.update_obstacles(-1)
+        blocked_path = None
+
+    assert blocked_path is not None
+
+    assert azeroth.remove_game_object(guid)
+    assert not azeroth.remove_game_object(guid)
+
+    rebuilt, pending, _ = azeroth.update_obstacles(-1)
+    assert rebuilt > 0 and pending == 0
+    assert azeroth.find_path(*start, *stop) == path
+
+    print('Game object obstacle test succeeded (display id %d)' % display_id)
+
+    # Northshire Abbey to the Eastvale Logging Camp is several clusters apart,
+    # so find_path plans it over the portal graph.  queued paths always use a
+    # flat search, and should agree with it
+    azeroth.load_all_adts()
+
+    start = (-8914.0, -133.0)
+    stop = (-9450.0, -1340.0)
+    start = (*start, max(azeroth.query_heights(*start)))
+    stop = (*stop, max(azeroth.query_heights(*stop)))
+
+    hierarchical_path = azeroth.find_path(*start, *stop)
+
+    request = azeroth.submit_path(*start, *stop)
+    flat_path = azeroth.poll_path(request)
+    while flat_path is None:
+        azeroth.update_paths(10000)
+        flat_path = azeroth.poll_path(request)
+
+    assert len(hierarchical_path) > 0 and len(flat_path) > 0
+    assert hierarchical_path[0] == flat_path[0]
+    assert hierarchical_path[-1] == flat_path[-1]
+    assert compute_path_length(hierarchical_path) <= \
+        compute_path_length(flat_path) * 1.25
+
+    print('Hierarchical path test succeeded')
+
     azeroth.load_adt_at(-9068, 413)
     zone, area = azeroth.get_zone_and_area(-9068.827148, 413.834045, 92.931786)
     zone2, area2 = azeroth.get_zone_and_area(-9069.045898, 413.626892, 92.868759)
@@ -40,6 +40,45 @@ def test_build(temp_dir):
 	if not mapbuild.bvh_files_exist(temp_dir):
 		raise Exception("map_files_exist returned False when it should be True")
 
+def test_incremental_build(temp_dir):
+	data_dir = os.path.dirname(__file__)
+
+	def snapshot():
+		result = {}
+		for root, _, files in os.walk(temp_dir):
+			for name in files:
+				path = os.path.join(root, name)
+				with open(path, "rb") as f:
+					result[path] = (os.path.getmtime(path), f.read())
+		return result
+
+	before = snapshot()
+
+	# mtimes may have a coarse resolution, so make sure a rewritten file would
+	# have a different one
+	time.sleep(2)
+
+	mapbuild.build_map(data_dir, temp_dir, "development", 8, "", True)
+
+	after = snapshot()
+
+	if before.keys() != after.keys():
+		raise Exception("Incremental build changed the set of output files")
+
+	nav_files = [path for path in before if path.endswith(".nav")]
+	if not nav_files:
+		raise Exception("No .nav files found after building development")
+
+	for path in nav_files:
+		if before[path][0] != after[path][0]:
+			raise Exception("Incremental build rebuilt unchanged {}".format(path))
+
+	for path in before:
+		if before[path][1] != after[path][1]:
+			raise Exception("Incremental build changed {}".format(path))
+
+	print("Incremental build check succeeded")
+
 def test_pathfind(temp_dir):
 	map_data = pathfind.Map(temp_dir, "development")
 
@@ -98,6 +137,105 @@ def test_pathfind(temp_dir):
 
 	print("Pathfind check succeeded")
 
+	if not map_data.are_connected(16303.294922, 16789.242188, 45.219631,
+		16200.139648, 16834.345703, 37.028622):
+		raise Exception("are_connected returned False for connected positions")
+
+	print("Connectivity check succeeded")
+
+	request = map_data.submit_path(16303.294922, 16789.242188, 45.219631,
+		16200.139648, 16834.345703, 37.028622)
+
+	sliced_path = map_data.poll_path(request)
+	while sliced_path is None:
+		map_data.update_paths(100)
+		sliced_path = map_data.poll_path(request)
+
+	if sliced_path != path:
+		raise Exception("Sliced path differs from blocking path.  Length: {} Expected: {}".format(
+			len(sliced_path), len(path)))
+
+	print("Sliced pathfind check succeeded")
+
+	# find_path plans routes between clusters (ADTs) which are not adjacent
+	# over the portal graph, while queued paths always use a flat search.  they
+	# should agree on where a path goes
+	map_data.load_all_adts()
+
+	def flat_find_path(start, stop):
+		request = map_data.submit_path(*start, *stop)
+		result = map_data.poll_path(request)
+		while result is None:
+			map_data.update_paths(1000)
+			result = map_data.poll_path(request)
+		return result
+
+	adt_size = 533.0 + 1.0 / 3.0
+	mid = 32.0 * adt_size
+
+	start = [16303.294922, 16789.242188, 45.219631]
+	start_adt_x = int((mid - start[1]) / adt_size)
+	start_adt_y = int((mid - start[0]) / adt_size)
+
+	# the first point with a flat path to it, in an ADT at least two clusters
+	# away from the start
+	def find_distant_stop():
+		for adt_x in range(64):
+			for adt_y in range(64):
+				if max(abs(adt_x - start_adt_x), abs(adt_y - start_adt_y)) < 2:
+					continue
+				if not map_data.adt_loaded(adt_x, adt_y):
+					continue
+				for i in range(16):
+					x = mid - (adt_y + (i // 4 + 0.5) / 4) * adt_size
+					y = mid - (adt_x + (i % 4 + 0.5) / 4) * adt_size
+					for z in map_data.query_heights(x, y):
+						path = flat_find_path(start, [x, y, z])
+						if len(path) != 0:
+							return [x, y, z], path
+		return None, []
+
+	stop, flat_path = find_distant_stop()
+
+	if stop is None:
+		raise Exception("No reachable position found two clusters from the start")
+
+	hierarchical_count = map_data.hierarchical_path_count()
+	hierarchical_path = map_data.find_path(*start, *stop)
+
+	if len(hierarchical_path) == 0:
+		raise Exception("Hierarchical path not found to {}".format(stop))
+
+	if map_data.hierarchical_path_count() != hierarchical_count + 1:
+		raise Exception("Path to {} was not planned over the portal graph".format(stop))
+
+	if hierarchical_path[0] != flat_path[0] or hierarchical_path[-1] != flat_path[-1]:
+		raise Exception("Hierarchical and flat paths have different endpoints")
+
+	hierarchical_length = compute_path_length(hierarchical_path)
+	flat_length = compute_path_length(flat_path)
+
+	if hierarchical_length > flat_length * 1.25:
+		raise Exception("Hierarchical path distance {} flat path distance {}".format(
+			hierarchical_length, flat_length))
+
+	print("Hierarchical pathfind check succeeded")
+
+	map_data.set_path_cache_capacity(16)
+	for i in range(2):
+		cached_path = map_data.find_path(16303.294922, 16789.242188, 45.219631,
+			16200.139648, 16834.345703, 37.028622)
+		if cached_path != path:
+			raise Exception("Cached path differs from uncached path")
+
+	hits, misses, _ = map_data.path_cache_statistics()
+	if hits != 1 or misses != 1:
+		raise Exception("Path cache hits: {} misses: {}".format(hits, misses))
+
+	map_data.set_path_cache_capacity(0)
+
+	print("Path cache check succeeded")
+
 	zone, area = map_data.get_zone_and_area(x, y, expected_z_values[-1])
 
 	if zone != 22 or area != 22:
@@ -172,6 +310,7 @@ def main():
 
 	try:
 		test_build(temp_dir)
+		test_incremental_build(temp_dir)
 		test_pathfind(temp_dir)
 	finally:
 		print("Removing temporary directory...")
@@ -1,10 +1,13 @@
 #include "AABBTree.hpp"
 
 #include "BinaryStream.hpp"
+#include "WorkerPool.hpp"
 
 #include <algorithm>
 #include <cassert>
 #include <cstdint>
+#include <limits>
+#include <vector>
 
 namespace math
 {
@@ -39,12 +42,45 @@ private:
     const int* m_indices;
     unsigned int m_axis;
 };
+
+// number of candidate split planes per axis considered at each node is one
+// less than this
+constexpr unsigned int BinCount = 16;
+
+constexpr unsigned int MaxFacesPerLeaf = 6;
+
+// models with fewer faces than this are always built on one thread
+constexpr unsigned int ParallelBuildFaces = 1 << 16;
+
+// smallest subtree built as a separate task
+constexpr unsigned int MinTaskFaces = 1 << 12;
+
+// limits on the work done by Optimize()
+constexpr int MaxOptimizePasses = 32;
+constexpr float OptimizeTolerance = 1e-5f;
+
+// cost of traversing an inner node relative to intersecting one face
+constexpr float TraversalCost = 0.125f;
+
+BoundingBox EmptyBounds()
+{
+    float min = std::numeric_limits<float>::lowest();
+    float max = std::numeric_limits<float>::max();
+
+    return BoundingBox({max, max, max}, {min, min, min});
+}
+
+unsigned int BinIndex(float centroid, float min, float scale)
+{
+    auto const bin = static_cast<unsigned int>((centroid - min) * scale);
+    return (std::min)(bin, BinCount - 1);
+}
 } // namespace
 
 AABBTree::AABBTree(const std::vector<Vertex>& vertices,
-                   const std::vector<int>& indices)
+                   const std::vector<int>& indices, unsigned int threads)
 {
-    Build(vertices, indices);
+    Build(vertices, indices, threads);
 }
 
 BoundingBox AABBTree::GetBoundingBox() const
@@ -56,49 +92,26 @@ BoundingBox AABBTree::GetBoundingBox() const
 
 void AABBTree::Serialize(utility::BinaryStream& stream) const
 {
+    // all records are multiples of four bytes, so every array stays aligned
+    // relative to the start of the tree
     auto const size =
         sizeof(std::uint32_t) *
             5 + // magic, Vector3 count, index count, node count, end magic
         sizeof(Vertex) * m_vertices.size() +      // vertices
         sizeof(std::int32_t) * m_indices.size() + // indices
-        (sizeof(std::uint8_t) + sizeof(std::uint32_t) + sizeof(BoundingBox)) *
-            m_nodes.size(); // nodes (numFaces + startFace/childen + bounds) *
-                            // count
+        sizeof(Node) * m_nodes.size();            // nodes
 
     auto ourStream = utility::BinaryStream(size);
 
     ourStream << StartMagic;
 
     ourStream << static_cast<std::uint32_t>(m_vertices.size());
-    ourStream.Write(&m_vertices[0], m_vertices.size() * sizeof(Vector3));
-
     ourStream << static_cast<std::uint32_t>(m_indices.size());
-
-    for (const auto& index : m_indices)
-    {
-        const std::int32_t idx = index;
-        ourStream << idx;
-    }
-
     ourStream << static_cast<std::uint32_t>(m_nodes.size());
 
-    for (const auto& node : m_nodes)
-    {
-        assert(node.numFaces < 8);
-
-        ourStream << static_cast<std::uint8_t>(node.numFaces);
-
-        if (!!node.numFaces)
-        {
-            // Write leaf node
-            ourStream << node.startFace << node.bounds;
-        }
-        else
-        {
-            // Write inner node
-            ourStream << node.children << node.bounds;
-        }
-    }
+    ourStream.Write(m_vertices.data(), m_vertices.size() * sizeof(Vertex));
+    ourStream.Write(m_indices.data(), m_indices.size() * sizeof(std::int32_t));
+    ourStream.Write(m_nodes.data(), m_nodes.size() * sizeof(Node));
 
     ourStream << EndMagic;
 
@@ -111,9 +124,37 @@ bool AABBTree::Deserialize(utility::BinaryStream& stream)
 {
     std::uint32_t magic;
     stream >> magic;
+
+    if (magic == LegacyStartMagic)
+        return DeserializeLegacy(stream);
+
     if (magic != StartMagic)
         return false;
 
+    std::uint32_t vertexCount, indexCount, nodeCount;
+    stream >> vertexCount >> indexCount >> nodeCount;
+
+    // a model without faces has neither indices nor nodes
+    assert(!indexCount == !nodeCount);
+
+    m_vertices.resize(vertexCount);
+    stream.ReadBytes(m_vertices.data(), vertexCount * sizeof(Vertex));
+
+    m_indices.resize(indexCount);
+    stream.ReadBytes(m_indices.data(), indexCount * sizeof(std::int32_t));
+
+    m_nodes.resize(nodeCount);
+    stream.ReadBytes(m_nodes.data(), nodeCount * sizeof(Node));
+
+    std::uint32_t endMagic;
+    stream >> endMagic;
+
+    return endMagic == EndMagic;
+}
+
+// the original format, which stores a variable length record per node
+bool AABBTree::DeserializeLegacy(utility::BinaryStream& stream)
+{
     std::uint32_t vertexCount;
     stream >> vertexCount;
 
@@ -127,13 +168,8 @@ bool AABBTree::Deserialize(utility::BinaryStream& stream)
 
     assert(indexCount > 0);
 
-    m_indices.reserve(indexCount);
-    for (auto i = 0u; i < indexCount; ++i)
-    {
-        std::int32_t index;
-        stream >> index;
-        m_indices.push_back(static_cast<int>(index));
-    }
+    m_indices.resize(indexCount);
+    stream.ReadBytes(&m_indices[0], indexCount * sizeof(std::int32_t));
 
     std::uint32_t nodeCount;
     stream >> nodeCount;
@@ -145,7 +181,7 @@ bool AABBTree::Deserialize(utility::BinaryStream& stream)
         std::uint8_t numFaces;
         stream >> numFaces;
 
-        m_nodes[i].numFaces = static_cast<unsigned int>(numFaces);
+        m_nodes[i].numFaces = static_cast<std::uint32_t>(numFaces);
 
         if (!!numFaces)
         {
@@ -196,33 +232,82 @@ BoundingBox AABBTree::CalculateFaceBounds(unsigned int* faces,
     return BoundingBox(minExtents, maxExtents);
 }
 
+BoundingBox AABBTree::CombineFaceBounds(const unsigned int* faces,
+                                        unsigned int numFaces) const
+{
+    auto result = EmptyBounds();
+
+    for (auto i = 0u; i < numFaces; ++i)
+        result.connectWith(m_faceBounds[faces[i]]);
+
+    return result;
+}
+
+void AABBTree::Build(const std::vector<Vertex>& verts,
+                     const std::vector<int>& indices, unsigned int threads)
+{
+    // the threads are only started for models large enough to use them
+    if (threads > 1 && indices.size() / 3 >= ParallelBuildFaces)
+    {
+        utility::WorkerPool pool(threads);
+        BuildTree(verts, indices, &pool);
+    }
+    else
+        BuildTree(verts, indices, nullptr);
+}
+
 void AABBTree::Build(const std::vector<Vertex>& verts,
-                     const std::vector<int>& indices)
+                     const std::vector<int>& indices, utility::WorkerPool& pool)
+{
+    BuildTree(verts, indices, &pool);
+}
+
+void AABBTree::BuildTree(const std::vector<Vertex>& verts,
+                         const std::vector<int>& indices,
+                         utility::WorkerPool* pool)
 {
     m_vertices = verts;
     m_indices = indices;
 
     m_faceBounds.clear();
+    m_faceCentroids.clear();
     m_faceIndices.clear();
 
     size_t numFaces = indices.size() / 3;
 
+    m_nodes.clear();
+
+    // a model without faces is left without nodes, and is serialized as an
+    // empty record
+    if (!numFaces)
+    {
+        m_vertices.clear();
+        m_indices.clear();
+        return;
+    }
+
     m_faceBounds.reserve(numFaces);
+    m_faceCentroids.reserve(numFaces);
     m_faceIndices.reserve(numFaces);
 
     for (auto i = 0u; i < numFaces; ++i)
     {
         m_faceIndices.push_back(i);
         m_faceBounds.push_back(CalculateFaceBounds(&i, 1));
+        m_faceCentroids.push_back(m_faceBounds.back().getCenter());
     }
 
-    m_freeNode = 1;
-    m_nodes.clear();
-    m_nodes.reserve(int(numFaces * 1.5f));
+    m_nodes.reserve(numFaces / MaxFacesPerLeaf * 2 + 1);
+    m_nodes.resize(1);
+
+    if (pool && pool->Threads() > 1 && numFaces >= ParallelBuildFaces)
+        BuildParallel(*pool);
+    else
+        BuildRecursive(m_nodes, 0, m_faceIndices.data(),
+                       static_cast<unsigned int>(numFaces), nullptr, 0);
 
-    BuildRecursive(0, m_faceIndices.data(),
-                   static_cast<unsigned int>(numFaces));
     m_faceBounds.clear();
+    m_faceCentroids.clear();
 
     // Reorder the model indices according to the face indices
     std::vector<int> sortedIndices(m_indices.size());
@@ -246,86 +331,137 @@ unsigned int AABBTree::GetLongestAxis(const Vector3& v)
     return (v.Y > v.Z) ? 1 : 2;
 }
 
-unsigned int AABBTree::PartitionMedian(Node& node, unsigned int* faces,
-                                       unsigned int numFaces)
+unsigned int AABBTree::PartitionMedian(const BoundingBox& bounds,
+                                       unsigned int* faces,
+                                       unsigned int numFaces) const
 {
-    unsigned int axis = GetLongestAxis(node.bounds.getVector());
+    unsigned int axis = GetLongestAxis(bounds.getVector());
     ModelFaceSorter predicate(m_vertices.data(), m_indices.data(), axis);
 
     std::nth_element(faces, faces + numFaces / 2, faces + numFaces, predicate);
     return numFaces / 2;
 }
 
-unsigned int AABBTree::PartitionSurfaceArea(Node& /*node*/, unsigned int* faces,
-                                            unsigned int numFaces)
+unsigned int AABBTree::PartitionSurfaceArea(const BoundingBox& bounds,
+                                            unsigned int* faces,
+                                            unsigned int numFaces) const
 {
-    unsigned int bestAxis = 0;
-    unsigned int bestIndex = 0;
+    struct Bin
+    {
+        BoundingBox bounds;
+        unsigned int count;
+    };
 
+    auto centroidBounds = EmptyBounds();
+    for (auto i = 0u; i < numFaces; ++i)
+        centroidBounds.update(m_faceCentroids[faces[i]]);
+
+    unsigned int bestAxis = 3;
+    unsigned int bestBin = 0;
     float bestCost = std::numeric_limits<float>::max();
 
     for (unsigned int axis = 0; axis < 3; ++axis)
     {
-        ModelFaceSorter predicate(m_vertices.data(), m_indices.data(), axis);
-        std::sort(faces, faces + numFaces, predicate);
+        auto const min = centroidBounds.MinCorner[axis];
+        auto const extent = centroidBounds.MaxCorner[axis] - min;
 
-        // Two passes over data to calculate upper and lower bounds
-        std::vector<float> cumulativeLower(numFaces);
-        std::vector<float> cumulativeUpper(numFaces);
+        // all centroids lie on one plane, so there is nothing to split
+        if (extent <= 0.f)
+            continue;
 
-        BoundingBox lower, upper;
+        auto const scale = BinCount / extent;
 
-        for (unsigned int i = 0; i < numFaces; ++i)
+        Bin bins[BinCount];
+        for (auto& bin : bins)
         {
-            lower.connectWith(m_faceBounds[faces[i]]);
-            upper.connectWith(m_faceBounds[faces[numFaces - i - 1]]);
+            bin.bounds = EmptyBounds();
+            bin.count = 0;
+        }
 
-            cumulativeLower[i] = lower.getSurfaceArea();
-            cumulativeUpper[numFaces - i - 1] = upper.getSurfaceArea();
+        for (auto i = 0u; i < numFaces; ++i)
+        {
+            auto& bin =
+                bins[BinIndex(m_faceCentroids[faces[i]][axis], min, scale)];
+            bin.bounds.connectWith(m_faceBounds[faces[i]]);
+            ++bin.count;
         }
 
-        float invTotalArea = 1.0f / cumulativeUpper[0];
+        // sweep from the right to find the area and count above each plane
+        float upperArea[BinCount];
+        unsigned int upperCount[BinCount];
+
+        auto upper = EmptyBounds();
+        auto count = 0u;
+        for (auto b = BinCount - 1; b > 0; --b)
+        {
+            upper.connectWith(bins[b].bounds);
+            count += bins[b].count;
+
+            upperArea[b] = upper.getSurfaceArea();
+            upperCount[b] = count;
+        }
 
-        // Test split positions
-        for (unsigned int i = 0; i < numFaces - 1; ++i)
+        // then from the left to evaluate each plane
+        auto lower = EmptyBounds();
+        count = 0;
+        for (auto b = 0u; b < BinCount - 1; ++b)
         {
-            float below = cumulativeLower[i] * invTotalArea;
-            float above = cumulativeUpper[i] * invTotalArea;
+            lower.connectWith(bins[b].bounds);
+            count += bins[b].count;
 
-            float cost = 0.125f + (below * i + above * (numFaces - i));
-            if (cost <= bestCost)
+            if (!count || !upperCount[b + 1])
+                continue;
+
+            auto const cost = lower.getSurfaceArea() * count +
+                              upperArea[b + 1] * upperCount[b + 1];
+
+            if (cost < bestCost)
             {
                 bestCost = cost;
-                bestIndex = i;
                 bestAxis = axis;
+                bestBin = b;
             }
         }
     }
 
-    // Sort faces by best axis
-    ModelFaceSorter predicate(m_vertices.data(), m_indices.data(), bestAxis);
-    std::sort(faces, faces + numFaces, predicate);
+    // every face has the same centroid, so split them evenly
+    if (bestAxis == 3)
+        return PartitionMedian(bounds, faces, numFaces);
+
+    auto const min = centroidBounds.MinCorner[bestAxis];
+    auto const scale =
+        BinCount / (centroidBounds.MaxCorner[bestAxis] - min);
 
-    return bestIndex + 1;
+    auto const middle =
+        std::partition(faces, faces + numFaces, [&](unsigned int face) {
+            return BinIndex(m_faceCentroids[face][bestAxis], min, scale) <=
+                   bestBin;
+        });
+
+    return static_cast<unsigned int>(middle - faces);
 }
 
-void AABBTree::BuildRecursive(unsigned int nodeIndex, unsigned int* faces,
-                              unsigned int numFaces)
+void AABBTree::BuildRecursive(std::vector<Node>& nodes,
+                              unsigned int nodeIndex, unsigned int* faces,
+                              unsigned int numFaces,
+                              std::vector<BuildTask>* tasks,
+                              unsigned int taskFaces) const
 {
-    const unsigned int maxFacesPerLeaf = 6;
-
-    // Allocate more nodes if out of nodes
-    if (nodeIndex >= m_nodes.size())
+    // small enough subtrees are left for a worker to build, and are linked
+    // back into this one when merging
+    if (tasks && numFaces <= taskFaces)
     {
-        int size = std::max(int(1.5f * m_nodes.size()), 512);
-        m_nodes.resize(size);
+        tasks->push_back(BuildTask {nodeIndex, faces, numFaces, {}});
+        return;
     }
 
-    auto& node = m_nodes[nodeIndex];
-    node.bounds = CalculateFaceBounds(faces, numFaces);
+    auto bounds = CombineFaceBounds(faces, numFaces);
 
-    if (numFaces <= maxFacesPerLeaf)
+    if (numFaces <= MaxFacesPerLeaf)
     {
+        auto& node = nodes[nodeIndex];
+
+        node.bounds = bounds;
         node.startFace =
             static_cast<std::uint32_t>(faces - m_faceIndices.data());
         assert(node.startFace ==
@@ -335,26 +471,294 @@ void AABBTree::BuildRecursive(unsigned int nodeIndex, unsigned int* faces,
     }
     else
     {
-        unsigned int leftCount = PartitionSurfaceArea(node, faces, numFaces);
+        unsigned int leftCount = PartitionSurfaceArea(bounds, faces, numFaces);
         unsigned int rightCount = numFaces - leftCount;
 
-        // Allocate 2 nodes
-        node.children = m_freeNode;
-        m_freeNode += 2;
+        // Allocate 2 nodes.  this may move the node being built, so it is
+        // only referred to by index
+        auto const children = static_cast<std::uint32_t>(nodes.size());
+        nodes.resize(nodes.size() + 2);
+
+        nodes[nodeIndex].bounds = bounds;
+        nodes[nodeIndex].children = children;
+        nodes[nodeIndex].numFaces = 0;
 
         // Split faces in half and build each side recursively
-        BuildRecursive(node.children + 0, faces, leftCount);
-        BuildRecursive(node.children + 1, faces + leftCount, rightCount);
+        BuildRecursive(nodes, children + 0, faces, leftCount, tasks,
+                       taskFaces);
+        BuildRecursive(nodes, children + 1, faces + leftCount, rightCount,
+                       tasks, taskFaces);
     }
 }
 
+void AABBTree::BuildParallel(utility::WorkerPool& pool)
+{
+    auto const numFaces = static_cast<unsigned int>(m_faceIndices.size());
+    auto const threadCount = static_cast<unsigned int>(pool.Threads());
+
+    // the top of the tree is built on this thread until the remaining
+    // subtrees are small enough to balance well across the workers
+    auto const taskFaces =
+        (std::max)(numFaces / (threadCount * 8), MinTaskFaces);
+
+    std::vector<Node> top(1);
+    std::vector<BuildTask> tasks;
+    BuildRecursive(top, 0, m_faceIndices.data(), numFaces, &tasks, taskFaces);
+
+    // every task partitions a disjoint range of faces into its own nodes
+    pool.Run(tasks.size(), [this, &tasks](size_t i) {
+        auto& task = tasks[i];
+        task.nodes.resize(1);
+        BuildRecursive(task.nodes, 0, task.faces, task.numFaces, nullptr, 0);
+    });
+
+    std::vector<const BuildTask*> links(top.size(), nullptr);
+    for (auto const& task : tasks)
+        links[task.node] = &task;
+
+    Merge(top, 0, 0, links);
+}
+
+void AABBTree::Merge(const std::vector<Node>& nodes, unsigned int nodeIndex,
+                     unsigned int outIndex,
+                     const std::vector<const BuildTask*>& links)
+{
+    if (!links.empty() && links[nodeIndex])
+    {
+        Merge(links[nodeIndex]->nodes, 0, outIndex, {});
+        return;
+    }
+
+    auto node = nodes[nodeIndex];
+
+    if (!!node.numFaces)
+    {
+        m_nodes[outIndex] = node;
+        return;
+    }
+
+    // children are numbered in the same order as a serial build would have
+    // allocated them, so that the output does not depend on scheduling
+    auto const children = static_cast<std::uint32_t>(m_nodes.size());
+    m_nodes.resize(m_nodes.size() + 2);
+
+    m_nodes[outIndex] = node;
+    m_nodes[outIndex].children = children;
+
+    Merge(nodes, node.children + 0, children + 0, links);
+    Merge(nodes, node.children + 1, children + 1, links);
+}
+
+float AABBTree::SurfaceAreaCost() const
+{
+    if (m_indices.empty() || m_nodes.empty())
+        return 0.f;
+
+    auto const rootArea = m_nodes.front().bounds.getSurfaceArea();
+
+    if (rootArea <= 0.f)
+        return 0.f;
+
+    // the expected cost of tracing a ray which hits the root, relative to
+    // intersecting one face
+    float cost = 0.f;
+
+    std::vector<unsigned int> stack {0};
+    while (!stack.empty())
+    {
+        auto const& node = m_nodes[stack.back()];
+        stack.pop_back();
+
+        auto const probability = node.bounds.getSurfaceArea() / rootArea;
+
+        if (!!node.numFaces)
+            cost += probability * node.numFaces;
+        else
+        {
+            cost += probability * TraversalCost;
+            stack.push_back(node.children + 0);
+            stack.push_back(node.children + 1);
+        }
+    }
+
+    return cost;
+}
+
+void AABBTree::Optimize()
+{
+    if (m_indices.empty() || m_nodes.empty())
+        return;
+
+    // each pass visits the tree bottom up, so that improvements near the
+    // leaves may be propagated towards the root by later passes
+    for (auto pass = 0; pass < MaxOptimizePasses; ++pass)
+        if (!OptimizeRecursive(0))
+            break;
+}
+
+bool AABBTree::OptimizeRecursive(unsigned int nodeIndex)
+{
+    auto const node = m_nodes[nodeIndex];
+
+    if (!!node.numFaces)
+        return false;
+
+    auto result = OptimizeRecursive(node.children + 0);
+    result |= OptimizeRecursive(node.children + 1);
+
+    while (RotateNode(nodeIndex))
+        result = true;
+
+    return result;
+}
+
+// swaps a child with a grandchild on the other side, or two grandchildren
+// with each other, whichever reduces the total area of this node's children
+// the most.  the bounds of this node and of every leaf are unaffected, so
+// nothing else in the tree changes cost.  nodes are swapped by moving their
+// records, which keeps every pair of siblings adjacent
+bool AABBTree::RotateNode(unsigned int nodeIndex)
+{
+    auto const children = m_nodes[nodeIndex].children;
+
+    unsigned int grandchildren[2][2];
+    bool inner[2];
+
+    for (auto i = 0u; i < 2; ++i)
+    {
+        auto const& child = m_nodes[children + i];
+        inner[i] = !child.numFaces;
+
+        if (inner[i])
+        {
+            grandchildren[i][0] = child.children + 0;
+            grandchildren[i][1] = child.children + 1;
+        }
+    }
+
+    auto const combined = [this](unsigned int a, unsigned int b) {
+        auto result = m_nodes[a].bounds;
+        result.connectWith(m_nodes[b].bounds);
+        return result;
+    };
+
+    auto const area = [this](unsigned int n) {
+        return m_nodes[n].bounds.getSurfaceArea();
+    };
+
+    float bestGain = 0.f;
+    unsigned int swapA = 0, swapB = 0;
+
+    // child i with grandchild j of the other child
+    for (auto i = 0u; i < 2; ++i)
+    {
+        auto const other = i ^ 1;
+
+        if (!inner[other])
+            continue;
+
+        for (auto j = 0u; j < 2; ++j)
+        {
+            auto const gain =
+                area(children + other) -
+                combined(children + i, grandchildren[other][j ^ 1])
+                    .getSurfaceArea();
+
+            if (gain > bestGain)
+            {
+                bestGain = gain;
+                swapA = children + i;
+                swapB = grandchildren[other][j];
+            }
+        }
+    }
+
+    // grandchild j of the first child with grandchild k of the second
+    if (inner[0] && inner[1])
+    {
+        for (auto j = 0u; j < 2; ++j)
+            for (auto k = 0u; k < 2; ++k)
+            {
+                auto const gain =
+                    area(children + 0) + area(children + 1) -
+                    combined(grandchildren[1][k], grandchildren[0][j ^ 1])
+                        .getSurfaceArea() -
+                    combined(grandchildren[0][j], grandchildren[1][k ^ 1])
+                        .getSurfaceArea();
+
+                if (gain > bestGain)
+                {
+                    bestGain = gain;
+                    swapA = grandchildren[0][j];
+                    swapB = grandchildren[1][k];
+                }
+            }
+    }
+
+    // ignore changes too small to outweigh floating point error
+    if (bestGain <= area(nodeIndex) * OptimizeTolerance)
+        return false;
+
+    std::swap(m_nodes[swapA], m_nodes[swapB]);
+
+    for (auto i = 0u; i < 2; ++i)
+    {
+        auto& child = m_nodes[children + i];
+        if (!child.numFaces)
+            child.bounds =
+                combined(child.children + 0, child.children + 1);
+    }
+
+    return true;
+}
+
 bool AABBTree::IntersectRay(Ray& ray, unsigned int* faceIndex) const
 {
+    if (m_indices.empty() || m_nodes.empty())
+        return false;
+
     float distance = ray.GetDistance();
     TraceRecursive(0, ray, faceIndex);
     return ray.GetDistance() < distance;
 }
 
+void AABBTree::IntersectBox(const BoundingBox& box,
+                            std::vector<int>& indices) const
+{
+    if (m_indices.empty())
+        return;
+
+    std::vector<unsigned int> stack(1, 0);
+
+    while (!stack.empty())
+    {
+        auto const& node = m_nodes[stack.back()];
+        stack.pop_back();
+
+        if (!node.bounds.intersect(box))
+            continue;
+
+        if (!node.numFaces)
+        {
+            stack.push_back(node.children + 0);
+            stack.push_back(node.children + 1);
+            continue;
+        }
+
+        for (auto i = node.startFace; i < node.startFace + node.numFaces; ++i)
+        {
+            auto const face = &m_indices[i * 3];
+
+            BoundingBox faceBounds(m_vertices[face[0]], m_vertices[face[0]]);
+            faceBounds.update(m_vertices[face[1]]);
+            faceBounds.update(m_vertices[face[2]]);
+
+            if (faceBounds.intersect(box))
+                indices.insert(indices.end(), face, face + 3);
+        }
+    }
+}
+
 void AABBTree::Trace(Ray& ray, unsigned int* faceIndex) const
 {
     struct StackEntry
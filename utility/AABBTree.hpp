@@ -8,6 +8,11 @@
 #include <cstdint>
 #include <vector>
 
+namespace utility
+{
+class WorkerPool;
+}
+
 namespace math
 {
 class AABBTree
@@ -21,11 +26,18 @@ private:
             std::uint32_t startFace;
         };
 
-        unsigned int numFaces = 0;
+        std::uint32_t numFaces = 0;
         BoundingBox bounds;
     };
 
-    static constexpr std::uint32_t StartMagic = 'BVH1';
+    // nodes are serialized as they are laid out in memory, so that the whole
+    // array may be read at once
+    static_assert(sizeof(Node) == 32, "Node must be a fixed size record");
+    static_assert(sizeof(int) == sizeof(std::int32_t),
+                  "indices are serialized as 32 bit integers");
+
+    static constexpr std::uint32_t StartMagic = 'BVH2';
+    static constexpr std::uint32_t LegacyStartMagic = 'BVH1';
     static constexpr std::uint32_t EndMagic = 'FOOB';
 
 public:
@@ -33,17 +45,36 @@ public:
     AABBTree(AABBTree&& other) = default;
     ~AABBTree() = default;
 
-    AABBTree(const std::vector<Vertex>& verts, const std::vector<int>& indices);
+    AABBTree(const std::vector<Vertex>& verts, const std::vector<int>& indices,
+             unsigned int threads = 1);
 
     AABBTree& operator=(AABBTree&& other) = default;
 
 public:
+    // large models are built on up to the given number of threads.  callers
+    // which are themselves run in parallel should leave this at one, or share
+    // a pool between them
     void Build(const std::vector<Vertex>& verts,
-               const std::vector<int>& indices);
+               const std::vector<int>& indices, unsigned int threads = 1);
+    void Build(const std::vector<Vertex>& verts,
+               const std::vector<int>& indices, utility::WorkerPool& pool);
     bool IntersectRay(Ray& ray, unsigned int* faceIndex = nullptr) const;
 
+    // appends the vertex indices of every triangle whose bounds overlap the
+    // box
+    void IntersectBox(const BoundingBox& box, std::vector<int>& indices) const;
+
     BoundingBox GetBoundingBox() const;
 
+    // surface area heuristic cost of the tree, useful for comparing the
+    // quality of different builds of the same geometry
+    float SurfaceAreaCost() const;
+
+    // rearranges the nodes of a built tree to reduce its surface area
+    // heuristic cost.  this is slower than building it, and leaves the
+    // serialized format unchanged
+    void Optimize();
+
     void Serialize(utility::BinaryStream& stream) const;
     bool Deserialize(utility::BinaryStream& stream);
 
@@ -51,15 +82,41 @@ public:
     const std::vector<int>& Indices() const { return m_indices; }
 
 private:
-    unsigned int PartitionMedian(Node& node, unsigned int* faces,
-                                 unsigned int numFaces);
-    unsigned int PartitionSurfaceArea(Node& node, unsigned int* faces,
-                                      unsigned int numFaces);
+    bool DeserializeLegacy(utility::BinaryStream& stream);
+
+    // a subtree built separately from the top of the tree
+    struct BuildTask
+    {
+        unsigned int node; // index of its root within the top of the tree
+        unsigned int* faces;
+        unsigned int numFaces;
+        std::vector<Node> nodes;
+    };
 
-    void BuildRecursive(unsigned int nodeIndex, unsigned int* faces,
-                        unsigned int numFaces);
+    unsigned int PartitionMedian(const BoundingBox& bounds,
+                                 unsigned int* faces,
+                                 unsigned int numFaces) const;
+    unsigned int PartitionSurfaceArea(const BoundingBox& bounds,
+                                      unsigned int* faces,
+                                      unsigned int numFaces) const;
+
+    void BuildRecursive(std::vector<Node>& nodes, unsigned int nodeIndex,
+                        unsigned int* faces, unsigned int numFaces,
+                        std::vector<BuildTask>* tasks,
+                        unsigned int taskFaces) const;
+    void BuildTree(const std::vector<Vertex>& verts,
+                   const std::vector<int>& indices, utility::WorkerPool* pool);
+    void BuildParallel(utility::WorkerPool& pool);
+    void Merge(const std::vector<Node>& nodes, unsigned int nodeIndex,
+               unsigned int outIndex,
+               const std::vector<const BuildTask*>& links);
     BoundingBox CalculateFaceBounds(unsigned int* faces,
                                     unsigned int numFaces) const;
+    BoundingBox CombineFaceBounds(const unsigned int* faces,
+                                  unsigned int numFaces) const;
+
+    bool OptimizeRecursive(unsigned int nodeIndex);
+    bool RotateNode(unsigned int nodeIndex);
 
     void Trace(Ray& ray, unsigned int* faceIndex) const;
     void TraceRecursive(unsigned int nodeIndex, Ray& ray,
@@ -72,14 +129,14 @@ private:
     static unsigned int GetLongestAxis(const Vector3& v);
 
 private:
-    unsigned int m_freeNode = 0;
-
     std::vector<Node> m_nodes;
 
     std::vector<Vertex> m_vertices;
     std::vector<int> m_indices;
 
+    // scratch space used only while building
     std::vector<BoundingBox> m_faceBounds;
+    std::vector<Vector3> m_faceCentroids;
     std::vector<unsigned int> m_faceIndices;
 };
 } // namespace math
\ No newline at end of file
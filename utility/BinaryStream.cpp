@@ -13,7 +13,7 @@
 namespace utility
 {
 BinaryStream::BinaryStream(
-    std::shared_ptr<std::vector<std::uint8_t>> shared_buffer)
+    std::shared_ptr<const std::vector<std::uint8_t>> shared_buffer)
     : m_sharedBuffer(shared_buffer), m_rpos(0), m_wpos(m_sharedBuffer->size())
 {
 }
@@ -56,16 +56,23 @@ BinaryStream::BinaryStream(BinaryStream&& other) noexcept
 
 BinaryStream& BinaryStream::operator=(BinaryStream&& other) noexcept
 {
-    if (other.m_sharedBuffer)
-        m_sharedBuffer = std::move(other.m_sharedBuffer);
-    else
-        m_buffer = std::move(other.m_buffer);
+    m_sharedBuffer = std::move(other.m_sharedBuffer);
+    m_buffer = std::move(other.m_buffer);
     m_rpos = other.m_rpos;
     m_wpos = other.m_wpos;
     other.m_rpos = other.m_wpos = 0;
     return *this;
 }
 
+void BinaryStream::Detach()
+{
+    if (!m_sharedBuffer)
+        return;
+
+    m_buffer = *m_sharedBuffer;
+    m_sharedBuffer.reset();
+}
+
 std::string BinaryStream::ReadString()
 {
     std::string ret;
@@ -99,7 +106,9 @@ void BinaryStream::Write(size_t position, const void* data, size_t length)
     if (!length)
         return;
 
-    auto const targetBuffer = buffer();
+    Detach();
+
+    auto const targetBuffer = &m_buffer;
 
     if (position + length > targetBuffer->size())
     {
@@ -201,6 +210,8 @@ bool BinaryStream::IsEOF()
 
 void BinaryStream::Compress()
 {
+    Detach();
+
     std::vector<std::uint8_t> buff(
         compressBound(static_cast<mz_ulong>(m_wpos)));
     auto newSize = static_cast<mz_ulong>(buff.size());
@@ -221,6 +232,8 @@ void BinaryStream::Compress()
 
 void BinaryStream::Decompress()
 {
+    Detach();
+
     std::vector<std::uint8_t> buffer(m_wpos);
     mz_stream stream;
     memset(&stream, 0, sizeof(stream));
@@ -273,13 +286,14 @@ BinaryStream& operator<<(BinaryStream& stream, const std::string& str)
 
 BinaryStream& operator<<(BinaryStream& stream, const BinaryStream& other)
 {
-    stream.Write(&other.m_buffer[0], other.wpos());
+    stream.Write(other.buffer()->data(), other.wpos());
     return stream;
 }
 
 std::ostream& operator<<(std::ostream& stream, const BinaryStream& data)
 {
-    stream.write(reinterpret_cast<const char*>(&data.m_buffer[0]), data.m_wpos);
+    stream.write(reinterpret_cast<const char*>(data.buffer()->data()),
+                 data.m_wpos);
     return stream;
 }
 } // namespace utility
\ No newline at end of file
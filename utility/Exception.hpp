@@ -172,6 +172,12 @@ namespace {
                 return "Temporary WMO obstacles are not supported";
             case Result::NO_DOODAD_SET_SPECIFIED_FOR_WMO_GAME_OBJECT:
                 return "No doodad set specified for WMO game object";
+            case Result::UNKNOWN_PATH_REQUEST:
+                return "Unknown path request";
+            case Result::PATH_REQUEST_IN_PROGRESS:
+                return "Path request in progress";
+            case Result::INVALID_GRAPH_FILE:
+                return "Invalid graph file";
 
             default:
                 return "Unknown error";
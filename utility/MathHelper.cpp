@@ -163,11 +163,12 @@ void Convert::VerticesToRecast(const std::vector<Vector3>& input,
 void Convert::VertexToWow(const float* input, Vector3& output)
 {
     // this is necessary in case input = output
-    const float x = input[1];
+    const float x = input[0];
+    const float z = input[1];
 
     output.X = -input[2];
-    output.Y = -input[0];
-    output.Z = x;
+    output.Y = -x;
+    output.Z = z;
 }
 
 void Convert::VerticesToWow(const float* input, int Vector3Count,
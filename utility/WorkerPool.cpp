@@ -0,0 +1,153 @@
+#include "utility/WorkerPool.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace utility
+{
+WorkerPool::WorkerPool(size_t threads) : m_threadCount(1), m_shutdown(false)
+{
+    SetThreads(threads);
+}
+
+WorkerPool::~WorkerPool()
+{
+    Stop();
+}
+
+void WorkerPool::Work()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    for (;;)
+    {
+        m_changed.wait(lock, [this]() { return m_shutdown || Pending(); });
+
+        if (m_shutdown)
+            return;
+
+        RunTask(lock, *Pending());
+    }
+}
+
+WorkerPool::Batch* WorkerPool::Pending(const Batch* after) const
+{
+    auto i = after ? std::find(m_batches.begin(), m_batches.end(), after) + 1
+                   : m_batches.begin();
+
+    for (; i != m_batches.end(); ++i)
+        if ((*i)->next < (*i)->count)
+            return *i;
+
+    return nullptr;
+}
+
+void WorkerPool::RunTask(std::unique_lock<std::mutex>& lock, Batch& batch)
+{
+    auto const i = batch.next++;
+    ++batch.running;
+
+    lock.unlock();
+
+    std::exception_ptr error;
+    try
+    {
+        (*batch.task)(i);
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+
+    lock.lock();
+
+    --batch.running;
+
+    if (error && !batch.error)
+        batch.error = error;
+
+    m_changed.notify_all();
+}
+
+void WorkerPool::Stop()
+{
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_shutdown = true;
+    }
+
+    m_changed.notify_all();
+
+    for (auto& thread : m_threads)
+        thread.join();
+
+    m_threads.clear();
+    m_shutdown = false;
+}
+
+void WorkerPool::SetThreads(size_t threads)
+{
+    Stop();
+
+    m_threadCount =
+        threads ? threads
+                : (std::max)(1u, std::thread::hardware_concurrency());
+}
+
+void WorkerPool::Run(size_t count, const std::function<void(size_t)>& task)
+{
+    if (!count)
+        return;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    // the threads already started are kept if starting another fails, and
+    // the batch is run on those
+    auto const wanted = (std::min)(m_threadCount, count) - 1;
+    if (m_threads.size() < wanted)
+    {
+        m_threads.reserve(m_threadCount - 1);
+
+        try
+        {
+            while (m_threads.size() < wanted)
+                m_threads.emplace_back(&WorkerPool::Work, this);
+        }
+        catch (const std::system_error&)
+        {
+        }
+    }
+
+    Batch batch {&task, count, 0, 0, nullptr};
+    m_batches.push_back(&batch);
+
+    m_changed.notify_all();
+
+    // once every task of this batch has been started, this thread helps with
+    // later batches, such as those run by its own tasks, rather than wait for
+    // them to finish.  an earlier batch might hold it for far longer
+    while (batch.next < batch.count || batch.running)
+    {
+        if (batch.next < batch.count)
+            RunTask(lock, batch);
+        else if (auto const other = Pending(&batch))
+            RunTask(lock, *other);
+        else
+            m_changed.wait(lock);
+    }
+
+    m_batches.erase(std::find(m_batches.begin(), m_batches.end(), &batch));
+
+    auto const error = batch.error;
+
+    lock.unlock();
+
+    if (error)
+        std::rethrow_exception(error);
+}
+} // namespace utility
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace utility
+{
+// a set of threads kept alive between batches of tasks.  the calling thread
+// takes part in every batch, so a pool of one thread starts none.  threads
+// are started by the first batch which has use for them.  batches may be run
+// from several threads at once, including from within a task, and any thread
+// with nothing left to do takes tasks from whichever batch has them
+class WorkerPool
+{
+private:
+    struct Batch
+    {
+        const std::function<void(size_t)>* task;
+        size_t count;
+        size_t next;
+        size_t running;
+        std::exception_ptr error;
+    };
+
+    size_t m_threadCount;
+    std::vector<std::thread> m_threads;
+
+    std::mutex m_mutex;
+
+    // signalled whenever a batch is added or a task finishes
+    std::condition_variable m_changed;
+
+    // every batch being run, oldest first
+    std::vector<Batch*> m_batches;
+
+    bool m_shutdown;
+
+    void Work();
+
+    // the oldest batch added after the given one with tasks not yet started,
+    // if any.  assumes ownership of the mutex
+    Batch* Pending(const Batch* after = nullptr) const;
+
+    // runs the next task of the batch.  assumes ownership of the mutex
+    void RunTask(std::unique_lock<std::mutex>& lock, Batch& batch);
+
+    void Stop();
+
+public:
+    explicit WorkerPool(size_t threads);
+    WorkerPool(const WorkerPool&) = delete;
+    ~WorkerPool();
+
+    // zero uses one thread per core.  this may not be called during Run
+    void SetThreads(size_t threads);
+    size_t Threads() const { return m_threadCount; }
+
+    // calls task(i) for every i below count, and returns once all of them have
+    // finished.  if any throws, the first exception is rethrown then
+    void Run(size_t count, const std::function<void(size_t)>& task);
+};
+} // namespace utility